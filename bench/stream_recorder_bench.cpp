@@ -0,0 +1,129 @@
+/**
+ * Measures whether StreamRecorder keeps up with received streams at the resolutions we subscribe to. Frames are fed
+ * from one thread at the stream's frame rate, as the SDK's render thread does, and the segments are removed after
+ * each run.
+ *
+ * Usage: stream_recorder_bench [directory] [seconds per run] [segment MB]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include "fmt/format.h"
+#include "metrics.h"
+#include "stream_recorder.h"
+
+struct Profile {
+    const char *name;
+    int width;
+    int height;
+    int fps;
+};
+
+constexpr Profile profiles[] = {
+        {"720p30",  1280, 720,  30},
+        {"1080p30", 1920, 1080, 30},
+        {"1080p60", 1920, 1080, 60},
+};
+
+double threadCpuSeconds() {
+    timespec now{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<double>(now.tv_sec) + static_cast<double>(now.tv_nsec) / 1e9;
+}
+
+double processCpuSeconds() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+void removeSegments(const std::string &directory, const std::string &name) {
+    for (const auto &entry: std::filesystem::directory_iterator(directory)) {
+        if (entry.path().filename().string().rfind(name + "-", 0) == 0) {
+            std::filesystem::remove(entry.path());
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string directory = argc > 1 ? argv[1] : ".";
+    auto seconds = argc > 2 ? std::atoi(argv[2]) : 10;
+    auto segmentMb = argc > 3 ? std::atoi(argv[3]) : 512;
+    if (!std::filesystem::is_directory(directory)) {
+        fmt::print(stderr, "'{}' is not a directory\n", directory);
+        return 1;
+    }
+
+    fmt::print("{:<8} {:>7} {:>7} {:>9} {:>9} {:>8} {:>8} {:>8} {:>9}\n",
+               "profile", "frames", "dropped", "writer %", "process %", "p50 us", "p99 us", "max us", "realtime");
+    for (const auto &profile: profiles) {
+        auto name = fmt::format("recorder-bench-{}", profile.name);
+        auto width = profile.width;
+        auto height = profile.height;
+
+        // A new value in every frame, so consecutive frames never write identical pages
+        std::vector<uint8_t> y(static_cast<size_t>(width) * height);
+        std::vector<uint8_t> u(static_cast<size_t>(width / 2) * (height / 2));
+        std::vector<uint8_t> v(u.size());
+        std::vector<int64_t> writeMicros;
+        int frames = seconds * profile.fps;
+        writeMicros.reserve(static_cast<size_t>(frames));
+
+        auto &dropped = Metrics::get("recorder." + name + ".frames_dropped");
+        auto droppedBefore = dropped.value();
+        {
+            StreamRecorder recorder(directory, name, RecordingFormat::Y4m,
+                                    static_cast<size_t>(std::max(1, segmentMb)) * 1024 * 1024, profile.fps);
+            auto frameInterval = std::chrono::microseconds(1000000 / profile.fps);
+            double writerCpu = 0;
+            auto startProcessCpu = processCpuSeconds();
+            auto start = std::chrono::steady_clock::now();
+            auto nextFrameTime = start;
+            for (int frame = 0; frame < frames; frame++) {
+                std::fill(y.begin(), y.end(), static_cast<uint8_t>(frame));
+                std::fill(u.begin(), u.end(), static_cast<uint8_t>(frame * 3));
+                std::fill(v.begin(), v.end(), static_cast<uint8_t>(frame * 7));
+                PlaneView planes[3] = {
+                        {y.data(), width,     width,     height},
+                        {u.data(), width / 2, width / 2, height / 2},
+                        {v.data(), width / 2, width / 2, height / 2},
+                };
+
+                // Filling the synthetic planes is the sender's work, only the write is charged to the recorder
+                auto writeStartCpu = threadCpuSeconds();
+                auto writeStart = std::chrono::steady_clock::now();
+                recorder.writeFrame(planes);
+                writerCpu += threadCpuSeconds() - writeStartCpu;
+                writeMicros.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - writeStart).count());
+
+                nextFrameTime += frameInterval;
+                std::this_thread::sleep_until(nextFrameTime);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            auto writerPct = writerCpu * 100 / elapsed.count();
+            // Includes the flusher thread and filling the planes
+            auto processPct = (processCpuSeconds() - startProcessCpu) * 100 / elapsed.count();
+
+            std::sort(writeMicros.begin(), writeMicros.end());
+            auto percentile = [&writeMicros](double fraction) {
+                return writeMicros[static_cast<size_t>(fraction * static_cast<double>(writeMicros.size() - 1))];
+            };
+            auto droppedFrames = dropped.value() - droppedBefore;
+            auto realtime = droppedFrames == 0 && percentile(0.99) < frameInterval.count();
+            fmt::print("{:<8} {:>7} {:>7} {:>9.1f} {:>9.1f} {:>8} {:>8} {:>8} {:>9}\n",
+                       profile.name, frames, droppedFrames, writerPct, processPct, percentile(0.5), percentile(0.99),
+                       writeMicros.back(), realtime ? "yes" : "no");
+        }
+        removeSegments(directory, name);
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+/**
+ * Measures how StripeRenderer scales with thread count at the resolutions we publish.
+ *
+ * Usage: stripe_render_bench [frames per run] [max threads] [static|low-motion|high-motion|noise]
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include "fmt/format.h"
+#include "load_profile.h"
+#include "stripe_renderer.h"
+
+struct Profile {
+    const char *name;
+    int width;
+    int height;
+    int fps;
+};
+
+constexpr Profile profiles[] = {
+        {"720p30",  1280, 720,  30},
+        {"1080p60", 1920, 1080, 60},
+        {"1080p120", 1920, 1080, 120},
+        {"4K30",    3840, 2160, 30},
+};
+
+int main(int argc, char **argv) {
+    auto frames = argc > 1 ? std::atoi(argv[1]) : 240;
+    auto maxThreads = argc > 2 ? std::atoi(argv[2]) : StripeRenderer::defaultThreadCount();
+    auto complexity = parseContentComplexity(argc > 3 ? argv[3] : "high-motion");
+    if (!complexity) {
+        fmt::print(stderr, "unknown content complexity '{}'\n", argv[3]);
+        return 1;
+    }
+
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    fmt::print("content: {}\n", toString(*complexity));
+    fmt::print("{:<10} {:>7} {:>7} {:>11} {:>10} {:>8} {:>9}\n",
+               "profile", "threads", "stripes", "stripe rows", "frames/s", "speedup", "realtime");
+    for (const auto &profile: profiles) {
+        std::vector<uint8_t> buffer(static_cast<size_t>(profile.width) * profile.height * 4);
+        double baseline = 0;
+        for (auto threads: threadCounts) {
+            StripeRenderer renderer(profile.width, profile.height, 4, threads);
+            LoadProfile loadProfile(*complexity, 1, profile.width, profile.height);
+            auto stripeFunction = [&loadProfile](uint8_t *rows, int firstRow, int rowCount) {
+                loadProfile.renderStripe(rows, firstRow, rowCount);
+            };
+
+            // Warm up the pool and the page tables before timing
+            loadProfile.beginFrame();
+            renderer.render(buffer.data(), stripeFunction);
+
+            auto start = std::chrono::steady_clock::now();
+            for (int frame = 0; frame < frames; frame++) {
+                loadProfile.beginFrame();
+                renderer.render(buffer.data(), stripeFunction);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            auto framesPerSecond = frames / elapsed.count();
+            if (baseline == 0) {
+                baseline = framesPerSecond;
+            }
+            fmt::print("{:<10} {:>7} {:>7} {:>11} {:>10.1f} {:>7.2f}x {:>9}\n",
+                       profile.name, renderer.threadCount(), renderer.stripeCount(), renderer.stripeRows(),
+                       framesPerSecond, framesPerSecond / baseline, framesPerSecond >= profile.fps ? "yes" : "no");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include "alloc_counter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+constinit std::atomic<uint64_t> allocations{0};
+constinit std::atomic<uint64_t> frees{0};
+
+void *countedAlloc(std::size_t size, std::size_t alignment) {
+    if (size == 0) {
+        size = 1;
+    }
+    while (true) {
+        void *memory = nullptr;
+        if (alignment <= alignof(std::max_align_t)) {
+            memory = std::malloc(size);
+        } else if (posix_memalign(&memory, alignment, size) != 0) {
+            memory = nullptr;
+        }
+        if (memory != nullptr) {
+            allocations.fetch_add(1, std::memory_order_relaxed);
+            return memory;
+        }
+        auto handler = std::get_new_handler();
+        if (handler == nullptr) {
+            return nullptr;
+        }
+        handler();
+    }
+}
+
+void *countedAllocOrThrow(std::size_t size, std::size_t alignment) {
+    auto memory = countedAlloc(size, alignment);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void countedFree(void *memory) {
+    if (memory != nullptr) {
+        frees.fetch_add(1, std::memory_order_relaxed);
+        std::free(memory);
+    }
+}
+
+}
+
+AllocationCounts allocationCounts() {
+    return AllocationCounts{allocations.load(std::memory_order_relaxed), frees.load(std::memory_order_relaxed)};
+}
+
+void *operator new(std::size_t size) {
+    return countedAllocOrThrow(size, 0);
+}
+
+void *operator new[](std::size_t size) {
+    return countedAllocOrThrow(size, 0);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    return countedAllocOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+    return countedAllocOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return countedAlloc(size, 0);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return countedAlloc(size, 0);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void operator delete(void *memory) noexcept {
+    countedFree(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+    countedFree(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+    countedFree(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept {
+    countedFree(memory);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept {
+    countedFree(memory);
+}
+
+void operator delete[](void *memory, std::align_val_t) noexcept {
+    countedFree(memory);
+}
+
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept {
+    countedFree(memory);
+}
+
+void operator delete[](void *memory, std::size_t, std::align_val_t) noexcept {
+    countedFree(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) noexcept {
+    countedFree(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &) noexcept {
+    countedFree(memory);
+}
@@ -0,0 +1,22 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+
+struct AllocationCounts {
+    uint64_t allocations;
+    uint64_t frees;
+
+    [[nodiscard]] int64_t live() const {
+        return static_cast<int64_t>(allocations - frees);
+    }
+};
+
+/**
+ * Calls to the global operator new and operator delete since the process started. alloc_counter.cpp replaces them
+ * with malloc/free wrappers that bump two relaxed atomic counters, so linking it in costs next to nothing. Memory
+ * allocated with malloc directly, by C code or the SDK, is not counted.
+ */
+AllocationCounts allocationCounts();
+
+#endif // ALLOC_COUNTER_H
@@ -0,0 +1,172 @@
+#include "audio_renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <opentok.h>
+#include <thread>
+#include "trace.h"
+
+namespace {
+
+constexpr auto blockDuration = std::chrono::milliseconds(10);
+
+int64_t nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+AudioRenderer::AudioRenderer(std::unique_ptr<AudioSink> sink, int jitterBufferMs)
+        : sink(std::move(sink)),
+          targetBlocks(std::clamp<size_t>(jitterBufferMs / 10, 1, decltype(jitterBuffer)::capacity() / 2)),
+          blocksRead(Metrics::get("audio.render.blocks_read")),
+          blocksPlayed(Metrics::get("audio.render.blocks_played")),
+          underruns(Metrics::get("audio.render.underruns")),
+          overruns(Metrics::get("audio.render.overruns")),
+          bufferedMs(Metrics::get("audio.render.buffered_ms")),
+          latencyUs(Metrics::get("audio.render.latency_us")),
+          maxLatencyUs(Metrics::get("audio.render.max_latency_us")) {}
+
+AudioRenderer::~AudioRenderer() {
+    stop();
+}
+
+bool AudioRenderer::start() {
+    if (started) {
+        return true;
+    }
+    // Blocks left over from before a stop would only play out late, no thread touches the buffer while stopped
+    while (jitterBuffer.size() > 0) {
+        jitterBuffer.pop();
+    }
+    exitThreads = false;
+    if (otk_thread_create(&renderThread, &render_thread_start_function, this) != 0) {
+        logger.error("{}: could not create render thread", __FUNCTION__);
+        return false;
+    }
+    if (otk_thread_create(&playoutThread, &playout_thread_start_function, this) != 0) {
+        logger.error("{}: could not create playout thread", __FUNCTION__);
+        exitThreads = true;
+        otk_thread_join(renderThread);
+        return false;
+    }
+    started = true;
+    return true;
+}
+
+void AudioRenderer::stop() {
+    if (!started) {
+        return;
+    }
+    exitThreads = true;
+    otk_thread_join(renderThread);
+    otk_thread_join(playoutThread);
+    started = false;
+}
+
+otk_thread_func_return_type AudioRenderer::render_thread_start_function(void *arg) {
+    auto _this = static_cast<AudioRenderer *>(arg);
+    if (_this == nullptr) {
+        otk_thread_func_return_value;
+    }
+
+    _this->logger.debug("{}: buffering {} ms before playout", __FUNCTION__, _this->targetBlocks * 10);
+    Trace::setThreadName("audio-renderer");
+    CpuAttachment cpuAttachment(_this->cpuAccount);
+
+    // Lands here only when the jitter buffer is full
+    AudioBlock discarded{};
+
+    auto nextBlockTime = std::chrono::steady_clock::now();
+    while (!_this->exitThreads.load()) {
+        auto block = _this->jitterBuffer.beginPush();
+        auto target = block != nullptr ? block : &discarded;
+        {
+            TRACE_SCOPE("otc_audio_device_read_render_data");
+            otc_audio_device_read_render_data(target->samples, blockSamples);
+        }
+        target->readTime = nowMicros();
+        _this->blocksRead.add();
+
+        if (block != nullptr) {
+            _this->jitterBuffer.commitPush();
+        } else {
+            _this->overruns.add();
+        }
+
+        nextBlockTime += blockDuration;
+        auto now = std::chrono::steady_clock::now();
+        if (nextBlockTime < now) {
+            nextBlockTime = now;
+        }
+        TRACE_SCOPE("sleep");
+        std::this_thread::sleep_until(nextBlockTime);
+    }
+
+    otk_thread_func_return_value;
+}
+
+otk_thread_func_return_type AudioRenderer::playout_thread_start_function(void *arg) {
+    auto _this = static_cast<AudioRenderer *>(arg);
+    if (_this == nullptr) {
+        otk_thread_func_return_value;
+    }
+
+    Trace::setThreadName("audio-playout");
+    CpuAttachment cpuAttachment(_this->cpuAccount);
+
+    static const int16_t silence[blockSamples] = {};
+    auto &jitterBuffer = _this->jitterBuffer;
+    bool buffering = true;
+
+    auto nextBlockTime = std::chrono::steady_clock::now();
+    while (!_this->exitThreads.load()) {
+        auto buffered = jitterBuffer.size();
+        _this->bufferedMs.set(static_cast<int64_t>(buffered * 10));
+
+        // Drift or a burst from the SDK, trim back to the target depth instead of playing it out late
+        if (buffered > _this->targetBlocks * 2) {
+            while (buffered > _this->targetBlocks) {
+                jitterBuffer.pop();
+                _this->overruns.add();
+                buffered--;
+            }
+        }
+
+        if (buffering && buffered >= _this->targetBlocks) {
+            buffering = false;
+        }
+
+        auto block = buffering ? nullptr : jitterBuffer.front();
+        {
+            TRACE_SCOPE("audio_sink_write");
+            if (block != nullptr) {
+                auto latency = nowMicros() - block->readTime;
+                _this->latencyUs.set(latency);
+                if (latency > _this->maxLatencyUs.value()) {
+                    _this->maxLatencyUs.set(latency);
+                }
+                _this->sink->write(block->samples, blockSamples);
+                jitterBuffer.pop();
+                _this->blocksPlayed.add();
+            } else {
+                if (!buffering) {
+                    _this->underruns.add();
+                    buffering = true;
+                }
+                _this->sink->write(silence, blockSamples);
+            }
+        }
+
+        nextBlockTime += blockDuration;
+        auto now = std::chrono::steady_clock::now();
+        if (nextBlockTime < now) {
+            nextBlockTime = now;
+        }
+        TRACE_SCOPE("sleep");
+        std::this_thread::sleep_until(nextBlockTime);
+    }
+
+    otk_thread_func_return_value;
+}
@@ -0,0 +1,81 @@
+#ifndef AUDIO_RENDERER_H
+#define AUDIO_RENDERER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include "audio_sink.h"
+#include "cpu_governor.h"
+#include "logger.h"
+#include "metrics.h"
+#include "otk_thread.h"
+#include "spsc_ring.h"
+
+/**
+ * Plays out received audio through an AudioSink.
+ *
+ * A render thread pulls 10 ms blocks from the SDK with otc_audio_device_read_render_data on an absolute 10 ms
+ * cadence and pushes them into a lock-free jitter buffer. A playout thread starts draining the buffer once it holds
+ * the target depth and hands one block every 10 ms to the sink. When the buffer runs dry it plays silence and waits
+ * for the target depth again (underrun). When it is full blocks are dropped, and once it holds more than twice the
+ * target it is trimmed back to the target depth (overrun), so latency stays bounded. The time a block spends between
+ * the SDK and the sink is exported as the render latency.
+ */
+class AudioRenderer {
+public:
+    static constexpr int samplingRate = 48000;
+    static constexpr int blockSamples = samplingRate / 100;
+
+    AudioRenderer(std::unique_ptr<AudioSink> sink, int jitterBufferMs);
+
+    ~AudioRenderer();
+
+    AudioRenderer(const AudioRenderer &) = delete;
+
+    AudioRenderer &operator=(const AudioRenderer &) = delete;
+
+    /**
+     * Accounts the render and playout threads' CPU time. Must be called before start().
+     */
+    void setCpuAccount(std::shared_ptr<CpuAccount> account) {
+        cpuAccount = std::move(account);
+    }
+
+    bool start();
+
+    void stop();
+
+private:
+    struct AudioBlock {
+        int16_t samples[blockSamples];
+        int64_t readTime;
+    };
+
+    static otk_thread_func_return_type render_thread_start_function(void *arg);
+
+    static otk_thread_func_return_type playout_thread_start_function(void *arg);
+
+    std::unique_ptr<AudioSink> sink;
+    size_t targetBlocks;
+
+    SpscRing<AudioBlock, 64> jitterBuffer;
+
+    otk_thread_t renderThread{};
+    otk_thread_t playoutThread{};
+    std::atomic<bool> exitThreads{false};
+    bool started{false};
+
+    Metric &blocksRead;
+    Metric &blocksPlayed;
+    Metric &underruns;
+    Metric &overruns;
+    Metric &bufferedMs;
+    Metric &latencyUs;
+    Metric &maxLatencyUs;
+
+    std::shared_ptr<CpuAccount> cpuAccount;
+
+    Logger logger{"AudioRenderer"};
+};
+
+#endif // AUDIO_RENDERER_H
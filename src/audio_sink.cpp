@@ -0,0 +1,137 @@
+#include "audio_sink.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+void writeLittleEndian(FILE *file, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        fputc(static_cast<int>((value >> (8 * i)) & 0xFF), file);
+    }
+}
+
+// Two seconds of 48 kHz stereo
+constexpr uint32_t sharedRingCapacity = 48000 * 2 * 2;
+
+// The RIFF chunk size, which counts the rest of the header as well, has to fit in 32 bits
+constexpr uint64_t maxWavDataBytes = 0xFFFFFFFFull - 36;
+
+}
+
+FileAudioSink::FileAudioSink(const std::string &path, int samplingRate, int channels)
+        : path(path), samplingRate(samplingRate), channels(channels) {
+    file = fopen(path.c_str(), "wb");
+    if (file != nullptr) {
+        writeHeader();
+    }
+}
+
+FileAudioSink::~FileAudioSink() {
+    if (file == nullptr) {
+        return;
+    }
+    fseek(file, 0, SEEK_SET);
+    writeHeader();
+    fclose(file);
+}
+
+bool FileAudioSink::write(const int16_t *samples, size_t sampleCount) {
+    if (file == nullptr || full) {
+        return false;
+    }
+    if (dataBytes + sampleCount * sizeof(int16_t) > maxWavDataBytes) {
+        full = true;
+        logger.warn("{}: {} reached the 4 GiB WAV size limit, dropping further audio", __FUNCTION__, path);
+        return false;
+    }
+    auto written = fwrite(samples, sizeof(int16_t), sampleCount, file);
+    dataBytes += written * sizeof(int16_t);
+    return written == sampleCount;
+}
+
+void FileAudioSink::writeHeader() {
+    auto data = static_cast<uint32_t>(dataBytes);
+    auto blockAlign = static_cast<uint32_t>(channels * sizeof(int16_t));
+    fwrite("RIFF", 1, 4, file);
+    writeLittleEndian(file, 36 + data, 4);
+    fwrite("WAVEfmt ", 1, 8, file);
+    writeLittleEndian(file, 16, 4);
+    writeLittleEndian(file, 1, 2); // PCM
+    writeLittleEndian(file, channels, 2);
+    writeLittleEndian(file, samplingRate, 4);
+    writeLittleEndian(file, samplingRate * blockAlign, 4);
+    writeLittleEndian(file, blockAlign, 2);
+    writeLittleEndian(file, 16, 2);
+    fwrite("data", 1, 4, file);
+    writeLittleEndian(file, data, 4);
+}
+
+SharedMemoryAudioSink::SharedMemoryAudioSink(const std::string &name, int samplingRate, int channels,
+                                             uint32_t capacity) : name(name) {
+    auto fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        return;
+    }
+    mappedBytes = sizeof(SharedAudioRing) + capacity * sizeof(int16_t);
+    if (ftruncate(fd, static_cast<off_t>(mappedBytes)) != 0) {
+        close(fd);
+        return;
+    }
+    auto mapped = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return;
+    }
+
+    ring = static_cast<SharedAudioRing *>(mapped);
+    ring->samplingRate = samplingRate;
+    ring->channels = channels;
+    ring->capacity = capacity;
+    ring->writePosition.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ring->magic = SharedAudioRing::expectedMagic;
+}
+
+SharedMemoryAudioSink::~SharedMemoryAudioSink() {
+    if (ring != nullptr) {
+        munmap(ring, mappedBytes);
+        shm_unlink(name.c_str());
+    }
+}
+
+bool SharedMemoryAudioSink::write(const int16_t *samples, size_t sampleCount) {
+    if (ring == nullptr) {
+        return false;
+    }
+    auto position = ring->writePosition.load(std::memory_order_relaxed);
+    while (sampleCount > 0) {
+        auto offset = position % ring->capacity;
+        auto chunk = std::min<size_t>(sampleCount, ring->capacity - offset);
+        memcpy(ring->samples() + offset, samples, chunk * sizeof(int16_t));
+        samples += chunk;
+        sampleCount -= chunk;
+        position += chunk;
+    }
+    ring->writePosition.store(position, std::memory_order_release);
+    return true;
+}
+
+std::unique_ptr<AudioSink> createAudioSink(std::string_view spec, int samplingRate, int channels) {
+    if (spec == "null") {
+        return std::make_unique<NullAudioSink>();
+    }
+    if (spec.starts_with("file:")) {
+        auto sink = std::make_unique<FileAudioSink>(std::string(spec.substr(5)), samplingRate, channels);
+        return sink->isOpen() ? std::move(sink) : nullptr;
+    }
+    if (spec.starts_with("shm:")) {
+        auto sink = std::make_unique<SharedMemoryAudioSink>(std::string(spec.substr(4)), samplingRate, channels,
+                                                            sharedRingCapacity);
+        return sink->isOpen() ? std::move(sink) : nullptr;
+    }
+    return nullptr;
+}
@@ -0,0 +1,108 @@
+#ifndef AUDIO_SINK_H
+#define AUDIO_SINK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "logger.h"
+
+/**
+ * Where rendered audio ends up. write() is called from a single thread with 16-bit interleaved PCM.
+ */
+class AudioSink {
+public:
+    virtual ~AudioSink() = default;
+
+    virtual bool write(const int16_t *samples, size_t sampleCount) = 0;
+};
+
+/**
+ * Discards everything, for measuring the render path on its own.
+ */
+class NullAudioSink : public AudioSink {
+public:
+    bool write(const int16_t *, size_t) override {
+        return true;
+    }
+};
+
+/**
+ * Writes a WAV file. The header's sizes are filled in when the sink is destroyed. They are 32 bits, so writing stops
+ * once the file reaches 4 GiB.
+ */
+class FileAudioSink : public AudioSink {
+public:
+    FileAudioSink(const std::string &path, int samplingRate, int channels);
+
+    ~FileAudioSink() override;
+
+    [[nodiscard]] bool isOpen() const {
+        return file != nullptr;
+    }
+
+    bool write(const int16_t *samples, size_t sampleCount) override;
+
+private:
+    void writeHeader();
+
+    std::string path;
+    FILE *file{nullptr};
+    int samplingRate;
+    int channels;
+    uint64_t dataBytes{0};
+    bool full{false};
+
+    Logger logger{"FileAudioSink"};
+};
+
+/**
+ * Shared memory layout of SharedMemoryAudioSink: this header followed by capacity samples. Readers map the object
+ * read-only, follow writePosition (in samples, monotonically increasing) and read samples()[position % capacity].
+ * A reader more than capacity samples behind has lost data.
+ */
+struct SharedAudioRing {
+    static constexpr uint32_t expectedMagic = 0x4F544B41; // "OTKA"
+
+    uint32_t magic;
+    uint32_t samplingRate;
+    uint32_t channels;
+    uint32_t capacity;
+    std::atomic<uint64_t> writePosition;
+
+    int16_t *samples() {
+        return reinterpret_cast<int16_t *>(this + 1);
+    }
+};
+
+/**
+ * Publishes audio into a POSIX shared memory ring, see SharedAudioRing.
+ */
+class SharedMemoryAudioSink : public AudioSink {
+public:
+    SharedMemoryAudioSink(const std::string &name, int samplingRate, int channels, uint32_t capacity);
+
+    ~SharedMemoryAudioSink() override;
+
+    [[nodiscard]] bool isOpen() const {
+        return ring != nullptr;
+    }
+
+    bool write(const int16_t *samples, size_t sampleCount) override;
+
+private:
+    std::string name;
+    SharedAudioRing *ring{nullptr};
+    size_t mappedBytes{0};
+};
+
+/**
+ * Creates a sink from "null", "file:<path>" or "shm:<name>". Returns nullptr if the spec is invalid or the sink
+ * cannot be opened.
+ */
+std::unique_ptr<AudioSink> createAudioSink(std::string_view spec, int samplingRate, int channels);
+
+#endif // AUDIO_SINK_H
@@ -0,0 +1,129 @@
+#include "backpressure.h"
+
+#include "trace.h"
+
+std::optional<BackpressurePolicy> parseBackpressurePolicy(std::string_view name) {
+    if (name == "none") {
+        return BackpressurePolicy::None;
+    }
+    if (name == "drop") {
+        return BackpressurePolicy::DropFrames;
+    }
+    if (name == "fps") {
+        return BackpressurePolicy::ReduceFps;
+    }
+    if (name == "resolution") {
+        return BackpressurePolicy::ReduceResolution;
+    }
+    return std::nullopt;
+}
+
+const char *toString(BackpressurePolicy policy) {
+    switch (policy) {
+        case BackpressurePolicy::None:
+            return "none";
+        case BackpressurePolicy::DropFrames:
+            return "drop";
+        case BackpressurePolicy::ReduceFps:
+            return "fps";
+        case BackpressurePolicy::ReduceResolution:
+            return "resolution";
+    }
+    return "unknown";
+}
+
+BackpressureController::BackpressureController(const BackpressureSettings &settings, std::string name)
+        : settings(settings), name(std::move(name)),
+          framesDelivered(Metrics::get(this->name + ".frames_delivered")),
+          framesFailed(Metrics::get(this->name + ".frames_failed")),
+          framesLate(Metrics::get(this->name + ".frames_late")),
+          framesDropped(Metrics::get(this->name + ".frames_dropped")),
+          levelGauge(Metrics::get(this->name + ".backpressure_level")),
+          degradations(Metrics::get(this->name + ".backpressure_degradations")),
+          recoveries(Metrics::get(this->name + ".backpressure_recoveries")) {
+    if (settings.policy == BackpressurePolicy::None) {
+        this->settings.maxLevel = 0;
+    }
+}
+
+bool BackpressureController::shouldDeliver(uint64_t frameSlot) {
+    if (settings.policy != BackpressurePolicy::DropFrames || level_ == 0) {
+        return true;
+    }
+    if ((frameSlot & ((uint64_t{1} << level_) - 1)) == 0) {
+        return true;
+    }
+    framesDropped.add();
+    return false;
+}
+
+void BackpressureController::onFrameDelivered(bool delivered, std::chrono::nanoseconds busy) {
+    if (delivered) {
+        framesDelivered.add();
+    } else {
+        framesFailed.add();
+    }
+
+    auto late = busy > budget(level_);
+    if (late) {
+        framesLate.add();
+    }
+
+    if (!delivered || late) {
+        headroomStreak = 0;
+        if (++deficitStreak >= settings.deficitFrames && level_ < settings.maxLevel) {
+            changeLevel(level_ + 1);
+        }
+        return;
+    }
+
+    deficitStreak = 0;
+    if (level_ == 0) {
+        return;
+    }
+
+    // Halving the resolution quarters the cost of a frame, the other policies keep the per-frame cost
+    auto restoredBusy = settings.policy == BackpressurePolicy::ReduceResolution ? busy * 4 : busy;
+    if (restoredBusy * 5 <= budget(level_ - 1) * 4) {
+        if (++headroomStreak >= settings.recoveryFrames) {
+            changeLevel(level_ - 1);
+        }
+    } else {
+        headroomStreak = 0;
+    }
+}
+
+std::chrono::nanoseconds BackpressureController::budget(int atLevel) const {
+    switch (settings.policy) {
+        case BackpressurePolicy::DropFrames:
+        case BackpressurePolicy::ReduceFps:
+            return frameInterval * (1 << atLevel);
+        case BackpressurePolicy::None:
+        case BackpressurePolicy::ReduceResolution:
+            break;
+    }
+    return frameInterval;
+}
+
+void BackpressureController::changeLevel(int newLevel) {
+    auto now = Trace::now();
+    if (newLevel > level_) {
+        degradations.add();
+        logger.warn("{}: {} frames behind, degrading to level {} ({})", name, deficitStreak, newLevel,
+                    toString(settings.policy));
+        if (Trace::enabled()) {
+            Trace::record("backpressure_degrade", now, now);
+        }
+    } else {
+        recoveries.add();
+        logger.debug("{}: headroom for {} frames, recovering to level {} ({})", name, headroomStreak, newLevel,
+                     toString(settings.policy));
+        if (Trace::enabled()) {
+            Trace::record("backpressure_recover", now, now);
+        }
+    }
+    level_ = newLevel;
+    levelGauge.set(newLevel);
+    deficitStreak = 0;
+    headroomStreak = 0;
+}
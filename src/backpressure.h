@@ -0,0 +1,115 @@
+#ifndef BACKPRESSURE_H
+#define BACKPRESSURE_H
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "logger.h"
+#include "metrics.h"
+
+enum class BackpressurePolicy {
+    // Only log, never degrade
+    None,
+    // Skip rendering and delivering frames, publishing 1 of every 2^level frame slots
+    DropFrames,
+    // Stretch the frame interval by 2^level
+    ReduceFps,
+    // Halve width and height per level
+    ReduceResolution
+};
+
+std::optional<BackpressurePolicy> parseBackpressurePolicy(std::string_view name);
+
+const char *toString(BackpressurePolicy policy);
+
+struct BackpressureSettings {
+    BackpressurePolicy policy = BackpressurePolicy::DropFrames;
+    // Consecutive late or failed frames before degrading one level
+    int deficitFrames = 5;
+    // Consecutive frames with headroom before recovering one level
+    int recoveryFrames = 30;
+    int maxLevel = 3;
+};
+
+/**
+ * Watches how long each frame takes to render and deliver, and steps the stream down when it cannot keep up.
+ *
+ * A frame is in deficit when delivery fails or when it is busy past its budget, the frame interval at the current
+ * level. After deficitFrames deficit frames in a row the controller degrades one level. It recovers one level after
+ * recoveryFrames frames in a row whose cost would fit the budget of the level above with 20% to spare, so it does
+ * not oscillate between two levels. Every step is logged, counted and recorded in the trace.
+ */
+class BackpressureController {
+public:
+    BackpressureController(const BackpressureSettings &settings, std::string name);
+
+    /**
+     * Whether the frame slot should be rendered and delivered at all. Dropped slots are counted.
+     */
+    bool shouldDeliver(uint64_t frameSlot);
+
+    /**
+     * Reports a rendered frame. busy is the time from the frame's scheduled start until delivery returned.
+     */
+    void onFrameDelivered(bool delivered, std::chrono::nanoseconds busy);
+
+    [[nodiscard]] int level() const {
+        return level_;
+    }
+
+    /**
+     * Frame interval multiplier for the current level.
+     */
+    [[nodiscard]] int intervalMultiplier() const {
+        return settings.policy == BackpressurePolicy::ReduceFps ? 1 << level_ : 1;
+    }
+
+    /**
+     * Width and height are shifted right by this much at the current level.
+     */
+    [[nodiscard]] int resolutionShift() const {
+        return settings.policy == BackpressurePolicy::ReduceResolution ? level_ : 0;
+    }
+
+    /**
+     * The interval frames are budgeted against before this controller's own degradation, including any fps the CPU
+     * governor has already taken off.
+     */
+    void setFrameInterval(std::chrono::nanoseconds interval) {
+        frameInterval = interval;
+    }
+
+    /**
+     * Caps the level, e.g. when the resolution cannot shrink further.
+     */
+    void setMaxLevel(int maxLevel) {
+        settings.maxLevel = maxLevel;
+    }
+
+private:
+    [[nodiscard]] std::chrono::nanoseconds budget(int atLevel) const;
+
+    void changeLevel(int newLevel);
+
+    BackpressureSettings settings;
+    std::string name;
+    std::chrono::nanoseconds frameInterval{0};
+
+    int level_{0};
+    int deficitStreak{0};
+    int headroomStreak{0};
+
+    Metric &framesDelivered;
+    Metric &framesFailed;
+    Metric &framesLate;
+    Metric &framesDropped;
+    Metric &levelGauge;
+    Metric &degradations;
+    Metric &recoveries;
+
+    Logger logger{"Backpressure"};
+};
+
+#endif // BACKPRESSURE_H
@@ -0,0 +1,253 @@
+#include "cpu_governor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include "trace.h"
+
+namespace {
+
+// Assumed saving of a level until it has been measured
+constexpr double defaultLevelSaving = 2.0;
+
+}
+
+QualityAdjustment QualityAdjustment::forLevel(int level) {
+    return QualityAdjustment{
+            std::min(level, 1),
+            level >= 2 ? level / 2 : 0,
+            level >= 3 ? (level - 1) / 2 : 0
+    };
+}
+
+ContentComplexity lowerComplexity(ContentComplexity complexity, int steps) {
+    return static_cast<ContentComplexity>(std::max(0, static_cast<int>(complexity) - steps));
+}
+
+CpuAccount::CpuAccount(std::string name, bool governed)
+        : name_(std::move(name)), governed_(governed),
+          usagePercent(Metrics::get("cpu." + name_ + ".percent")),
+          levelGauge(Metrics::get("cpu." + name_ + ".level")),
+          threadGauge(Metrics::get("cpu." + name_ + ".threads")),
+          degradations(Metrics::get("cpu." + name_ + ".degradations")),
+          recoveries(Metrics::get("cpu." + name_ + ".recoveries")) {}
+
+void CpuAccount::attach(otk_thread_t thread) {
+    clockid_t clock;
+    if (pthread_getcpuclockid(thread, &clock) != 0) {
+        return;
+    }
+    std::lock_guard lock(threadsMutex);
+    threads.push_back(AttachedThread{thread, clock});
+}
+
+void CpuAccount::detach(otk_thread_t thread) {
+    std::lock_guard lock(threadsMutex);
+    auto it = std::find_if(threads.begin(), threads.end(), [thread](const AttachedThread &attached) {
+        return otk_thread_equal(attached.thread, thread);
+    });
+    if (it != threads.end()) {
+        detachedTime += readClock(it->clock);
+        threads.erase(it);
+    }
+}
+
+std::chrono::nanoseconds CpuAccount::cpuTime() {
+    std::lock_guard lock(threadsMutex);
+    auto total = detachedTime;
+    for (const auto &attached: threads) {
+        total += readClock(attached.clock);
+    }
+    return total;
+}
+
+size_t CpuAccount::threadCount() {
+    std::lock_guard lock(threadsMutex);
+    return threads.size();
+}
+
+std::chrono::nanoseconds CpuAccount::readClock(clockid_t clock) {
+    timespec time{};
+    if (clock_gettime(clock, &time) != 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+}
+
+CpuAttachment::CpuAttachment(std::shared_ptr<CpuAccount> account, otk_thread_t thread)
+        : account(std::move(account)), thread(thread) {
+    if (this->account) {
+        this->account->attach(thread);
+    }
+}
+
+CpuAttachment::~CpuAttachment() {
+    if (account) {
+        account->detach(thread);
+    }
+}
+
+CpuAttachment::CpuAttachment(CpuAttachment &&other) noexcept
+        : account(std::move(other.account)), thread(other.thread) {
+    other.account.reset();
+}
+
+CpuGovernor::CpuGovernor(CpuGovernorSettings settings) : settings(settings) {
+    this->settings.interval = std::max(this->settings.interval, std::chrono::milliseconds(10));
+    Metrics::get("cpu.budget_percent").set(std::max(0, settings.budgetPercent));
+}
+
+CpuGovernor::~CpuGovernor() {
+    stop();
+}
+
+std::shared_ptr<CpuAccount> CpuGovernor::addAccount(std::string name, bool governed) {
+    auto account = std::make_shared<CpuAccount>(std::move(name), governed);
+    std::lock_guard lock(accountsMutex);
+    accounts.push_back(account);
+    return account;
+}
+
+bool CpuGovernor::start() {
+    if (running) {
+        return true;
+    }
+    {
+        // Threads may have attached before the governor started, their first window starts now
+        std::lock_guard lock(accountsMutex);
+        for (auto &account: accounts) {
+            account->lastCpuTime = account->cpuTime();
+        }
+    }
+    exitGovernorThread = false;
+    if (otk_thread_create(&governorThread, &governor_thread_start_function, this) != 0) {
+        logger.error("{}: could not create governor thread", __FUNCTION__);
+        return false;
+    }
+    running = true;
+    return true;
+}
+
+void CpuGovernor::stop() {
+    if (!running) {
+        return;
+    }
+    exitGovernorThread = true;
+    otk_thread_join(governorThread);
+    running = false;
+}
+
+otk_thread_func_return_type CpuGovernor::governor_thread_start_function(void *arg) {
+    auto _this = static_cast<CpuGovernor *>(arg);
+    if (_this == nullptr) {
+        otk_thread_func_return_value;
+    }
+
+    _this->logger.debug("{}: {}% of a core per stream, sampled every {} ms", __FUNCTION__,
+                        _this->settings.budgetPercent, _this->settings.interval.count());
+    Trace::setThreadName("cpu-governor");
+
+    auto lastSample = std::chrono::steady_clock::now();
+    auto nextSample = lastSample + _this->settings.interval;
+    while (!_this->exitGovernorThread.load()) {
+        // Short sleeps so stopping does not wait for a whole interval
+        std::this_thread::sleep_for(std::min(_this->settings.interval, std::chrono::milliseconds(100)));
+        auto now = std::chrono::steady_clock::now();
+        if (now < nextSample) {
+            continue;
+        }
+        _this->sample(now - lastSample);
+        lastSample = now;
+        nextSample = now + _this->settings.interval;
+    }
+
+    otk_thread_func_return_value;
+}
+
+void CpuGovernor::sample(std::chrono::nanoseconds elapsed) {
+    TRACE_SCOPE("cpu_governor_sample");
+
+    std::vector<std::shared_ptr<CpuAccount>> snapshot;
+    {
+        std::lock_guard lock(accountsMutex);
+        snapshot = accounts;
+    }
+
+    for (auto &account: snapshot) {
+        auto cpuTime = account->cpuTime();
+        auto usage = static_cast<double>((cpuTime - account->lastCpuTime).count()) /
+                     static_cast<double>(elapsed.count()) * 100.0;
+        account->lastCpuTime = cpuTime;
+        account->usagePercent.set(std::lround(usage));
+        account->threadGauge.set(static_cast<int64_t>(account->threadCount()));
+
+        if (!account->governed() || settings.budgetPercent <= 0) {
+            continue;
+        }
+        if (account->settleWindows > 0) {
+            account->settleWindows--;
+            continue;
+        }
+
+        auto level = account->level();
+        if (account->measureDegradeSaving) {
+            account->measureDegradeSaving = false;
+            if (usage > 0) {
+                account->levelSavings.resize(level - 1, defaultLevelSaving);
+                account->levelSavings.push_back(std::clamp(account->usageBeforeDegrade / usage, 1.0, 16.0));
+            }
+        }
+
+        if (usage > settings.budgetPercent) {
+            account->headroomStreak = 0;
+            if (++account->overBudgetStreak >= settings.degradeWindows && level < settings.maxLevel) {
+                account->usageBeforeDegrade = usage;
+                account->measureDegradeSaving = true;
+                changeLevel(*account, level + 1, usage);
+            }
+            continue;
+        }
+
+        account->overBudgetStreak = 0;
+        if (level == 0) {
+            continue;
+        }
+        auto saving = static_cast<int>(account->levelSavings.size()) >= level ? account->levelSavings[level - 1]
+                                                                               : defaultLevelSaving;
+        if (usage * saving * 5 <= settings.budgetPercent * 4) {
+            if (++account->headroomStreak >= settings.recoverWindows) {
+                changeLevel(*account, level - 1, usage);
+            }
+        } else {
+            account->headroomStreak = 0;
+        }
+    }
+}
+
+void CpuGovernor::changeLevel(CpuAccount &account, int newLevel, double usage) {
+    auto now = Trace::now();
+    auto adjustment = QualityAdjustment::forLevel(newLevel);
+    if (newLevel > account.level()) {
+        account.degradations.add();
+        logger.warn("{}: at {:.0f}% of a core, budget {}%, degrading to level {} (complexity -{}, fps /{}, size /{})",
+                    account.name(), usage, settings.budgetPercent, newLevel, adjustment.complexitySteps,
+                    1 << adjustment.fpsShift, 1 << adjustment.resolutionShift);
+        if (Trace::enabled()) {
+            Trace::record("cpu_degrade", now, now);
+        }
+    } else {
+        account.recoveries.add();
+        account.levelSavings.resize(std::min(account.levelSavings.size(), static_cast<size_t>(newLevel)));
+        logger.debug("{}: at {:.0f}% of a core, budget {}%, recovering to level {} (complexity -{}, fps /{}, "
+                     "size /{})", account.name(), usage, settings.budgetPercent, newLevel,
+                     adjustment.complexitySteps, 1 << adjustment.fpsShift, 1 << adjustment.resolutionShift);
+        if (Trace::enabled()) {
+            Trace::record("cpu_recover", now, now);
+        }
+    }
+    account.level_.store(newLevel, std::memory_order_relaxed);
+    account.levelGauge.set(newLevel);
+    account.overBudgetStreak = 0;
+    account.headroomStreak = 0;
+    account.settleWindows = 1;
+}
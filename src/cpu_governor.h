@@ -0,0 +1,189 @@
+#ifndef CPU_GOVERNOR_H
+#define CPU_GOVERNOR_H
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "load_profile.h"
+#include "logger.h"
+#include "metrics.h"
+#include "otk_thread.h"
+
+struct CpuGovernorSettings {
+    // CPU each governed stream may use, 100 is one core. 0 only measures, negative disables the governor
+    int budgetPercent = -1;
+    std::chrono::milliseconds interval{1000};
+    // Windows over budget in a row before degrading one level
+    int degradeWindows = 3;
+    // Windows in a row whose cost would fit the budget at the level above with 20% to spare before recovering
+    int recoverWindows = 10;
+    int maxLevel = 5;
+};
+
+/**
+ * What a governor level takes away from a stream: content complexity steps first, then alternately halving the frame
+ * rate and the width and height.
+ */
+struct QualityAdjustment {
+    int complexitySteps;
+    int fpsShift;
+    int resolutionShift;
+
+    static QualityAdjustment forLevel(int level);
+};
+
+ContentComplexity lowerComplexity(ContentComplexity complexity, int steps);
+
+/**
+ * The threads doing one stream's work, or a piece of shared work such as audio, and the CPU time they have used.
+ *
+ * Threads attach with their otk_thread_t and must detach before they are joined. Their CPU clocks come from
+ * pthread_getcpuclockid, the per-thread CLOCK_THREAD_CPUTIME_ID, so the governor can read them from its own thread.
+ * A detaching thread's CPU time is kept, so short-lived threads are still accounted for.
+ */
+class CpuAccount {
+public:
+    CpuAccount(std::string name, bool governed);
+
+    CpuAccount(const CpuAccount &) = delete;
+
+    CpuAccount &operator=(const CpuAccount &) = delete;
+
+    [[nodiscard]] const std::string &name() const {
+        return name_;
+    }
+
+    /**
+     * Accounts that are not governed are only measured, their level stays 0.
+     */
+    [[nodiscard]] bool governed() const {
+        return governed_;
+    }
+
+    [[nodiscard]] int level() const {
+        return level_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] QualityAdjustment adjustment() const {
+        return QualityAdjustment::forLevel(level());
+    }
+
+    void attach(otk_thread_t thread);
+
+    void detach(otk_thread_t thread);
+
+    /**
+     * CPU time of every thread that has attached so far.
+     */
+    std::chrono::nanoseconds cpuTime();
+
+    size_t threadCount();
+
+private:
+    friend class CpuGovernor;
+
+    struct AttachedThread {
+        otk_thread_t thread;
+        clockid_t clock;
+    };
+
+    static std::chrono::nanoseconds readClock(clockid_t clock);
+
+    const std::string name_;
+    const bool governed_;
+    std::atomic<int> level_{0};
+
+    std::mutex threadsMutex;
+    std::vector<AttachedThread> threads;
+    std::chrono::nanoseconds detachedTime{0};
+
+    // Only touched on the governor thread
+    std::chrono::nanoseconds lastCpuTime{0};
+    int overBudgetStreak{0};
+    int headroomStreak{0};
+    // The window in which the level changed mixes two levels and is not judged
+    int settleWindows{0};
+    double usageBeforeDegrade{0};
+    bool measureDegradeSaving{false};
+    // How much cheaper each level made the stream, to predict the cost of recovering
+    std::vector<double> levelSavings;
+
+    Metric &usagePercent;
+    Metric &levelGauge;
+    Metric &threadGauge;
+    Metric &degradations;
+    Metric &recoveries;
+};
+
+/**
+ * Attaches a thread to an account for the lifetime of the attachment. Does nothing without an account.
+ */
+class CpuAttachment {
+public:
+    explicit CpuAttachment(std::shared_ptr<CpuAccount> account, otk_thread_t thread = otk_thread_self());
+
+    ~CpuAttachment();
+
+    CpuAttachment(CpuAttachment &&other) noexcept;
+
+    CpuAttachment(const CpuAttachment &) = delete;
+
+    CpuAttachment &operator=(const CpuAttachment &) = delete;
+
+    CpuAttachment &operator=(CpuAttachment &&) = delete;
+
+private:
+    std::shared_ptr<CpuAccount> account;
+    otk_thread_t thread;
+};
+
+/**
+ * Keeps each governed stream within a CPU budget on shared hosts.
+ *
+ * Every interval a governor thread reads the CPU time of each account's threads and exports it as
+ * cpu.<account>.percent. A governed account that is over budget for degradeWindows windows in a row moves one level
+ * down the QualityAdjustment ladder, which its publisher applies from the next frame. The saving each step brought
+ * is remembered, and the account recovers a level after recoverWindows windows in a row in which its usage, scaled
+ * back up by that saving, would fit the budget with 20% to spare, so it does not oscillate between two levels.
+ * Every step is logged, counted and recorded in the trace.
+ */
+class CpuGovernor {
+public:
+    explicit CpuGovernor(CpuGovernorSettings settings);
+
+    ~CpuGovernor();
+
+    CpuGovernor(const CpuGovernor &) = delete;
+
+    CpuGovernor &operator=(const CpuGovernor &) = delete;
+
+    std::shared_ptr<CpuAccount> addAccount(std::string name, bool governed);
+
+    bool start();
+
+    void stop();
+
+private:
+    static otk_thread_func_return_type governor_thread_start_function(void *arg);
+
+    void sample(std::chrono::nanoseconds elapsed);
+
+    void changeLevel(CpuAccount &account, int newLevel, double usage);
+
+    CpuGovernorSettings settings;
+
+    std::mutex accountsMutex;
+    std::vector<std::shared_ptr<CpuAccount>> accounts;
+
+    otk_thread_t governorThread{};
+    std::atomic<bool> exitGovernorThread{false};
+    bool running{false};
+
+    Logger logger{"CpuGovernor"};
+};
+
+#endif // CPU_GOVERNOR_H
@@ -0,0 +1,100 @@
+#include "downscaler.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void downscaleArgb(const uint8_t *src, int srcWidth, int srcHeight,
+                   uint8_t *dst, int dstWidth, int dstHeight, int firstRow, int rowCount) {
+    if (dstWidth * 2 == srcWidth && dstHeight * 2 == srcHeight) {
+        downscaleArgbHalf(src, srcWidth, dst, dstWidth, firstRow, rowCount);
+    } else {
+        downscaleArgbBilinear(src, srcWidth, srcHeight, dst, dstWidth, dstHeight, firstRow, rowCount);
+    }
+}
+
+void downscaleArgbHalf(const uint8_t *src, int srcWidth, uint8_t *dst, int dstWidth, int firstRow, int rowCount) {
+    auto srcStride = static_cast<size_t>(srcWidth) * 4;
+    auto dstStride = static_cast<size_t>(dstWidth) * 4;
+
+    for (int y = firstRow; y < firstRow + rowCount; y++) {
+        auto top = src + static_cast<size_t>(y) * 2 * srcStride;
+        auto bottom = top + srcStride;
+        auto out = dst + static_cast<size_t>(y) * dstStride;
+        int x = 0;
+
+#if defined(__SSE2__)
+        // Four output pixels per iteration from eight input pixels on each of the two rows
+        const auto zero = _mm_setzero_si128();
+        const auto rounding = _mm_set1_epi16(2);
+        for (; x + 4 <= dstWidth; x += 4) {
+            auto topLeft = _mm_loadu_si128(reinterpret_cast<const __m128i *>(top + x * 8));
+            auto topRight = _mm_loadu_si128(reinterpret_cast<const __m128i *>(top + x * 8 + 16));
+            auto bottomLeft = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + x * 8));
+            auto bottomRight = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + x * 8 + 16));
+
+            // Vertical sums in 16 bits, two pixels per register
+            auto sum0 = _mm_add_epi16(_mm_unpacklo_epi8(topLeft, zero), _mm_unpacklo_epi8(bottomLeft, zero));
+            auto sum1 = _mm_add_epi16(_mm_unpackhi_epi8(topLeft, zero), _mm_unpackhi_epi8(bottomLeft, zero));
+            auto sum2 = _mm_add_epi16(_mm_unpacklo_epi8(topRight, zero), _mm_unpacklo_epi8(bottomRight, zero));
+            auto sum3 = _mm_add_epi16(_mm_unpackhi_epi8(topRight, zero), _mm_unpackhi_epi8(bottomRight, zero));
+
+            // Horizontal pair sums: low 64 bits hold the even pixel, high 64 bits the odd pixel
+            auto pixels01 = _mm_add_epi16(_mm_unpacklo_epi64(sum0, sum1), _mm_unpackhi_epi64(sum0, sum1));
+            auto pixels23 = _mm_add_epi16(_mm_unpacklo_epi64(sum2, sum3), _mm_unpackhi_epi64(sum2, sum3));
+            pixels01 = _mm_srli_epi16(_mm_add_epi16(pixels01, rounding), 2);
+            pixels23 = _mm_srli_epi16(_mm_add_epi16(pixels23, rounding), 2);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x * 4), _mm_packus_epi16(pixels01, pixels23));
+        }
+#endif
+
+        for (; x < dstWidth; x++) {
+            for (int channel = 0; channel < 4; channel++) {
+                auto sum = top[x * 8 + channel] + top[x * 8 + 4 + channel] +
+                           bottom[x * 8 + channel] + bottom[x * 8 + 4 + channel];
+                out[x * 4 + channel] = static_cast<uint8_t>((sum + 2) >> 2);
+            }
+        }
+    }
+}
+
+void downscaleArgbBilinear(const uint8_t *src, int srcWidth, int srcHeight,
+                           uint8_t *dst, int dstWidth, int dstHeight, int firstRow, int rowCount) {
+    auto srcStride = static_cast<size_t>(srcWidth) * 4;
+    auto dstStride = static_cast<size_t>(dstWidth) * 4;
+
+    // 16.16 fixed point, sampling at pixel centres
+    auto stepX = (static_cast<int64_t>(srcWidth) << 16) / dstWidth;
+    auto stepY = (static_cast<int64_t>(srcHeight) << 16) / dstHeight;
+    auto maxX = static_cast<int64_t>(srcWidth - 1) << 16;
+    auto maxY = static_cast<int64_t>(srcHeight - 1) << 16;
+
+    for (int y = firstRow; y < firstRow + rowCount; y++) {
+        auto sourceY = std::clamp(y * stepY + stepY / 2 - (1 << 15), int64_t{0}, maxY);
+        auto row = static_cast<int>(sourceY >> 16);
+        auto nextRow = std::min(row + 1, srcHeight - 1);
+        auto weightY = static_cast<uint32_t>((sourceY >> 8) & 0xFF);
+        auto top = src + row * srcStride;
+        auto bottom = src + nextRow * srcStride;
+        auto out = dst + static_cast<size_t>(y) * dstStride;
+
+        for (int x = 0; x < dstWidth; x++) {
+            auto sourceX = std::clamp(x * stepX + stepX / 2 - (1 << 15), int64_t{0}, maxX);
+            auto column = static_cast<int>(sourceX >> 16);
+            auto nextColumn = std::min(column + 1, srcWidth - 1);
+            auto weightX = static_cast<uint32_t>((sourceX >> 8) & 0xFF);
+
+            for (int channel = 0; channel < 4; channel++) {
+                auto topValue = top[column * 4 + channel] * (256 - weightX) + top[nextColumn * 4 + channel] * weightX;
+                auto bottomValue = bottom[column * 4 + channel] * (256 - weightX) +
+                                   bottom[nextColumn * 4 + channel] * weightX;
+                auto value = (topValue * (256 - weightY) + bottomValue * weightY + (1 << 15)) >> 16;
+                out[x * 4 + channel] = static_cast<uint8_t>(value);
+            }
+        }
+    }
+}
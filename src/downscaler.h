@@ -0,0 +1,22 @@
+#ifndef DOWNSCALER_H
+#define DOWNSCALER_H
+
+#include <cstdint>
+
+/**
+ * Downscales tightly packed ARGB32 frames, writing destination rows [firstRow, firstRow + rowCount) so that the work
+ * can be split into stripes.
+ *
+ * Exact 2:1 reductions use a 2x2 box filter, vectorized with SSE2 where available. Any other ratio falls back to
+ * bilinear filtering, which does not prefilter and aliases beyond 2:1, so callers chain reductions of at most 2:1
+ * such as one layer from the layer above it.
+ */
+void downscaleArgb(const uint8_t *src, int srcWidth, int srcHeight,
+                   uint8_t *dst, int dstWidth, int dstHeight, int firstRow, int rowCount);
+
+void downscaleArgbHalf(const uint8_t *src, int srcWidth, uint8_t *dst, int dstWidth, int firstRow, int rowCount);
+
+void downscaleArgbBilinear(const uint8_t *src, int srcWidth, int srcHeight,
+                           uint8_t *dst, int dstWidth, int dstHeight, int firstRow, int rowCount);
+
+#endif // DOWNSCALER_H
@@ -0,0 +1,57 @@
+#include "frame_pool.h"
+
+#include <iterator>
+
+std::shared_ptr<uint8_t> FramePool::acquire(size_t size) {
+    std::unique_ptr<uint8_t[]> buffer;
+    {
+        std::lock_guard lock(mutex);
+        auto &buffers = freeBuffers[size];
+        if (!buffers.empty()) {
+            buffer = std::move(buffers.back());
+            buffers.pop_back();
+            freeBytes -= size;
+        } else {
+            allocatedBytes_ += size;
+        }
+    }
+    if (!buffer) {
+        buffer = std::make_unique<uint8_t[]>(size);
+    }
+
+    // The deleter keeps the pool alive for as long as any of its buffers is in use
+    return {buffer.release(), [pool = shared_from_this(), size](uint8_t *released) {
+        pool->release(released, size);
+    }};
+}
+
+void FramePool::setMaxFreeBytes(size_t bytes) {
+    std::lock_guard lock(mutex);
+    maxFreeBytes = bytes;
+    trim();
+}
+
+size_t FramePool::allocatedBytes() const {
+    std::lock_guard lock(mutex);
+    return allocatedBytes_;
+}
+
+void FramePool::release(uint8_t *buffer, size_t size) {
+    std::lock_guard lock(mutex);
+    freeBuffers[size].emplace_back(buffer);
+    freeBytes += size;
+    trim();
+}
+
+void FramePool::trim() {
+    while (freeBytes > maxFreeBytes) {
+        auto largest = std::prev(freeBuffers.end());
+        if (largest->second.empty()) {
+            freeBuffers.erase(largest);
+            continue;
+        }
+        largest->second.pop_back();
+        freeBytes -= largest->first;
+        allocatedBytes_ -= largest->first;
+    }
+}
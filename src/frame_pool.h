@@ -0,0 +1,57 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Recycles frame buffers of any size. A buffer goes back to its size class when the last reference to it is
+ * released, so once every layer has gone through a few frames no more memory is allocated.
+ */
+class FramePool : public std::enable_shared_from_this<FramePool> {
+public:
+    static std::shared_ptr<FramePool> create() {
+        return std::shared_ptr<FramePool>(new FramePool());
+    }
+
+    std::shared_ptr<uint8_t> acquire(size_t size);
+
+    /**
+     * Caps the bytes kept for reuse. Free buffers beyond it are freed now, largest first, and buffers released while
+     * at the cap are freed instead of kept. Unlimited by default.
+     */
+    void setMaxFreeBytes(size_t bytes);
+
+    [[nodiscard]] size_t allocatedBytes() const;
+
+private:
+    FramePool() = default;
+
+    void release(uint8_t *buffer, size_t size);
+
+    // Needs mutex
+    void trim();
+
+    mutable std::mutex mutex;
+    std::map<size_t, std::vector<std::unique_ptr<uint8_t[]>>> freeBuffers;
+    size_t allocatedBytes_{0};
+    size_t freeBytes{0};
+    size_t maxFreeBytes{std::numeric_limits<size_t>::max()};
+};
+
+/**
+ * An ARGB32 frame with a tightly packed stride, width * 4 bytes.
+ */
+struct VideoFrame {
+    std::shared_ptr<uint8_t> buffer;
+    int width{0};
+    int height{0};
+    uint64_t index{0};
+};
+
+#endif // FRAME_POOL_H
@@ -0,0 +1,226 @@
+#include "image_decoder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace {
+
+// Large enough for 8K, small enough that a corrupt header cannot ask for gigabytes
+constexpr int64_t maxPixels = 8192LL * 8192;
+
+uint32_t argb(uint32_t alpha, uint32_t red, uint32_t green, uint32_t blue) {
+    return alpha << 24 | red << 16 | green << 8 | blue;
+}
+
+bool validSize(int64_t width, int64_t height) {
+    return width > 0 && height > 0 && width * height <= maxPixels;
+}
+
+VideoFrame allocateFrame(FramePool &pool, int width, int height) {
+    VideoFrame frame;
+    frame.width = width;
+    frame.height = height;
+    frame.buffer = pool.acquire(static_cast<size_t>(width) * height * 4);
+    return frame;
+}
+
+/**
+ * Reads one decimal PPM header field, skipping whitespace and # comments before it.
+ */
+bool readPpmField(const uint8_t *data, size_t size, size_t &offset, int64_t &value) {
+    while (offset < size) {
+        if (data[offset] == '#') {
+            while (offset < size && data[offset] != '\n') {
+                offset++;
+            }
+        } else if (std::isspace(data[offset])) {
+            offset++;
+        } else {
+            break;
+        }
+    }
+    if (offset >= size || !std::isdigit(data[offset])) {
+        return false;
+    }
+    value = 0;
+    while (offset < size && std::isdigit(data[offset]) && value <= 65535 * 65535LL) {
+        value = value * 10 + (data[offset++] - '0');
+    }
+    return true;
+}
+
+VideoFrame decodePpm(const uint8_t *data, size_t size, FramePool &pool) {
+    size_t offset = 2;
+    int64_t width;
+    int64_t height;
+    int64_t maxValue;
+    if (!readPpmField(data, size, offset, width) || !readPpmField(data, size, offset, height) ||
+        !readPpmField(data, size, offset, maxValue) || !validSize(width, height) || maxValue < 1 ||
+        maxValue > 65535 || offset >= size || !std::isspace(data[offset])) {
+        return {};
+    }
+    // A single whitespace character separates the header from the samples
+    offset++;
+
+    auto sampleBytes = maxValue > 255 ? 2 : 1;
+    auto pixelCount = static_cast<size_t>(width * height);
+    if (size - offset < pixelCount * 3 * sampleBytes) {
+        return {};
+    }
+
+    auto frame = allocateFrame(pool, static_cast<int>(width), static_cast<int>(height));
+    auto pixels = reinterpret_cast<uint32_t *>(frame.buffer.get());
+    auto samples = data + offset;
+    if (maxValue == 255) {
+        for (size_t i = 0; i < pixelCount; i++, samples += 3) {
+            pixels[i] = argb(0xFF, samples[0], samples[1], samples[2]);
+        }
+        return frame;
+    }
+
+    auto sample = [&samples, sampleBytes, maxValue]() {
+        uint32_t value = sampleBytes == 2 ? samples[0] << 8 | samples[1] : samples[0];
+        samples += sampleBytes;
+        return static_cast<uint32_t>((std::min<int64_t>(value, maxValue) * 255 + maxValue / 2) / maxValue);
+    };
+    for (size_t i = 0; i < pixelCount; i++) {
+        auto red = sample();
+        auto green = sample();
+        auto blue = sample();
+        pixels[i] = argb(0xFF, red, green, blue);
+    }
+    return frame;
+}
+
+uint32_t readBigEndian32(const uint8_t *data) {
+    return static_cast<uint32_t>(data[0]) << 24 | static_cast<uint32_t>(data[1]) << 16 |
+           static_cast<uint32_t>(data[2]) << 8 | data[3];
+}
+
+/**
+ * The QOI format as specified at qoiformat.org: a 14 byte header, a stream of chunks and an 8 byte end marker.
+ */
+VideoFrame decodeQoi(const uint8_t *data, size_t size, FramePool &pool) {
+    constexpr size_t headerSize = 14;
+    constexpr size_t endMarkerSize = 8;
+    constexpr uint8_t opRgb = 0xFE;
+    constexpr uint8_t opRgba = 0xFF;
+    constexpr uint8_t opIndex = 0x00;
+    constexpr uint8_t opDiff = 0x40;
+    constexpr uint8_t opLuma = 0x80;
+    constexpr uint8_t opRun = 0xC0;
+    constexpr uint8_t tagMask = 0xC0;
+
+    if (size < headerSize + endMarkerSize) {
+        return {};
+    }
+    auto width = static_cast<int64_t>(readBigEndian32(data + 4));
+    auto height = static_cast<int64_t>(readBigEndian32(data + 8));
+    auto channels = data[12];
+    if (!validSize(width, height) || (channels != 3 && channels != 4)) {
+        return {};
+    }
+
+    auto frame = allocateFrame(pool, static_cast<int>(width), static_cast<int>(height));
+    auto pixels = reinterpret_cast<uint32_t *>(frame.buffer.get());
+    auto pixelCount = static_cast<size_t>(width * height);
+
+    uint8_t seen[64][4] = {};
+    uint8_t red = 0;
+    uint8_t green = 0;
+    uint8_t blue = 0;
+    uint8_t alpha = 255;
+    size_t offset = headerSize;
+    auto chunksEnd = size - endMarkerSize;
+    size_t run = 0;
+    for (size_t i = 0; i < pixelCount; i++) {
+        if (run > 0) {
+            run--;
+        } else {
+            if (offset >= chunksEnd) {
+                return {};
+            }
+            auto op = data[offset++];
+            if (op == opRgb) {
+                if (chunksEnd - offset < 3) {
+                    return {};
+                }
+                red = data[offset];
+                green = data[offset + 1];
+                blue = data[offset + 2];
+                offset += 3;
+            } else if (op == opRgba) {
+                if (chunksEnd - offset < 4) {
+                    return {};
+                }
+                red = data[offset];
+                green = data[offset + 1];
+                blue = data[offset + 2];
+                alpha = data[offset + 3];
+                offset += 4;
+            } else if ((op & tagMask) == opIndex) {
+                red = seen[op][0];
+                green = seen[op][1];
+                blue = seen[op][2];
+                alpha = seen[op][3];
+            } else if ((op & tagMask) == opDiff) {
+                red += ((op >> 4) & 0x03) - 2;
+                green += ((op >> 2) & 0x03) - 2;
+                blue += (op & 0x03) - 2;
+            } else if ((op & tagMask) == opLuma) {
+                if (offset >= chunksEnd) {
+                    return {};
+                }
+                auto next = data[offset++];
+                auto greenDiff = (op & 0x3F) - 32;
+                green += greenDiff;
+                red += greenDiff - 8 + ((next >> 4) & 0x0F);
+                blue += greenDiff - 8 + (next & 0x0F);
+            } else if ((op & tagMask) == opRun) {
+                // The current pixel is the first of the run
+                run = op & 0x3F;
+            }
+
+            auto &slot = seen[(red * 3 + green * 5 + blue * 7 + alpha * 11) % 64];
+            slot[0] = red;
+            slot[1] = green;
+            slot[2] = blue;
+            slot[3] = alpha;
+        }
+        pixels[i] = argb(alpha, red, green, blue);
+    }
+    return frame;
+}
+
+}
+
+bool readImageSize(const uint8_t *data, size_t size, int &width, int &height) {
+    int64_t headerWidth = 0;
+    int64_t headerHeight = 0;
+    if (size >= 3 && data[0] == 'P' && data[1] == '6' && std::isspace(data[2])) {
+        size_t offset = 2;
+        if (!readPpmField(data, size, offset, headerWidth) || !readPpmField(data, size, offset, headerHeight)) {
+            return false;
+        }
+    } else if (size >= 12 && std::memcmp(data, "qoif", 4) == 0) {
+        headerWidth = static_cast<int64_t>(readBigEndian32(data + 4));
+        headerHeight = static_cast<int64_t>(readBigEndian32(data + 8));
+    }
+    if (!validSize(headerWidth, headerHeight)) {
+        return false;
+    }
+    width = static_cast<int>(headerWidth);
+    height = static_cast<int>(headerHeight);
+    return true;
+}
+
+VideoFrame decodeImage(const uint8_t *data, size_t size, FramePool &pool) {
+    if (size >= 3 && data[0] == 'P' && data[1] == '6' && std::isspace(data[2])) {
+        return decodePpm(data, size, pool);
+    }
+    if (size >= 4 && std::memcmp(data, "qoif", 4) == 0) {
+        return decodeQoi(data, size, pool);
+    }
+    return {};
+}
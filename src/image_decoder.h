@@ -0,0 +1,21 @@
+#ifndef IMAGE_DECODER_H
+#define IMAGE_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include "frame_pool.h"
+
+/**
+ * Decodes a binary PPM (P6) or QOI image, told apart by their magic bytes, into an ARGB32 frame whose buffer comes
+ * from the pool. PPM images are opaque, QOI images keep their alpha channel. Returns a frame with an empty buffer if
+ * the data is not a well-formed image in either format.
+ */
+VideoFrame decodeImage(const uint8_t *data, size_t size, FramePool &pool);
+
+/**
+ * Reads the width and height from a PPM or QOI header without decoding the pixels. Returns false if the header is not
+ * well-formed, which does not guarantee that the rest of the image decodes.
+ */
+bool readImageSize(const uint8_t *data, size_t size, int &width, int &height);
+
+#endif // IMAGE_DECODER_H
@@ -0,0 +1,281 @@
+#include "image_sequence_source.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <dirent.h>
+#include <stdexcept>
+#include "image_decoder.h"
+#include "trace.h"
+
+namespace {
+
+bool isImage(const std::string &name) {
+    auto dot = name.rfind('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    auto extension = name.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    return extension == "ppm" || extension == "qoi";
+}
+
+/**
+ * Reads a whole file into data, reusing its capacity.
+ */
+bool readFile(const std::string &path, std::vector<uint8_t> &data) {
+    auto file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool read = false;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        auto size = ftell(file);
+        if (size > 0 && fseek(file, 0, SEEK_SET) == 0) {
+            data.resize(static_cast<size_t>(size));
+            read = fread(data.data(), 1, data.size(), file) == data.size();
+        }
+    }
+    fclose(file);
+    return read;
+}
+
+size_t frameBytes(const VideoFrame &frame) {
+    return static_cast<size_t>(frame.width) * frame.height * 4;
+}
+
+}
+
+ImageSequenceSource::ImageSequenceSource(ImageSequenceSettings settings)
+        : settings(std::move(settings)),
+          cacheBudget(static_cast<size_t>(std::max(1, this->settings.cacheMb)) * 1024 * 1024),
+          hits(Metrics::get("images.hits")),
+          misses(Metrics::get("images.misses")),
+          hitRatio(Metrics::get("images.hit_ratio_pct")),
+          decodes(Metrics::get("images.decodes")),
+          decodeMicros(Metrics::get("images.decode_us")),
+          decodeErrors(Metrics::get("images.decode_errors")),
+          redecodes(Metrics::get("images.redecodes")),
+          evictions(Metrics::get("images.evictions")),
+          cachedFrames(Metrics::get("images.cached_frames")),
+          cachedBytes(Metrics::get("images.cache_bytes")),
+          poolBytes(Metrics::get("images.pool_bytes")) {
+    auto directory = opendir(this->settings.directory.c_str());
+    if (directory == nullptr) {
+        throw std::invalid_argument("ImageSequenceSource: cannot read " + this->settings.directory);
+    }
+    while (auto entry = readdir(directory)) {
+        std::string name = entry->d_name;
+        if (isImage(name)) {
+            paths.push_back(this->settings.directory + "/" + name);
+        }
+    }
+    closedir(directory);
+
+    if (paths.empty()) {
+        throw std::invalid_argument("ImageSequenceSource: no .ppm or .qoi images in " + this->settings.directory);
+    }
+    std::sort(paths.begin(), paths.end());
+    failed.resize(paths.size());
+    decoded.resize(paths.size());
+
+    // Only the header is read, the first frame is decoded by the workers like any other
+    std::vector<uint8_t> file;
+    for (const auto &path: paths) {
+        if (readFile(path, file) && readImageSize(file.data(), file.size(), width_, height_)) {
+            break;
+        }
+    }
+    if (width_ == 0) {
+        throw std::invalid_argument("ImageSequenceSource: no readable image in " + this->settings.directory);
+    }
+}
+
+ImageSequenceSource::~ImageSequenceSource() {
+    stop();
+}
+
+bool ImageSequenceSource::start() {
+    if (!decoders.empty()) {
+        return true;
+    }
+    {
+        std::lock_guard lock(mutex);
+        exitDecoders = false;
+    }
+    for (int i = 0; i < std::max(1, settings.decodeThreads); i++) {
+        otk_thread_t decoder;
+        if (otk_thread_create(&decoder, &decoder_thread_start_function, this) != 0) {
+            logger.error("{}: could not create decoder thread", __FUNCTION__);
+            stop();
+            return false;
+        }
+        decoders.push_back(decoder);
+    }
+    logger.debug("{}: {} images from {}, {} MiB cache, decoding {} ahead on {} threads", __FUNCTION__, paths.size(),
+                 settings.directory, settings.cacheMb, settings.prefetchFrames, decoders.size());
+    return true;
+}
+
+void ImageSequenceSource::stop() {
+    if (decoders.empty()) {
+        return;
+    }
+    {
+        std::lock_guard lock(mutex);
+        exitDecoders = true;
+    }
+    decodeQueued.notify_all();
+    for (auto decoder: decoders) {
+        otk_thread_join(decoder);
+    }
+    decoders.clear();
+}
+
+VideoFrame ImageSequenceSource::frame(uint64_t index) {
+    std::lock_guard lock(mutex);
+    auto count = paths.size();
+    if (failedCount == count) {
+        return {};
+    }
+    while (failed[index % count]) {
+        index++;
+    }
+    auto image = index % count;
+
+    VideoFrame frame;
+    auto it = cache.find(image);
+    if (it != cache.end()) {
+        lru.splice(lru.begin(), lru, it->second.lru);
+        frame = it->second.frame;
+        frame.index = index;
+        hits.add();
+    } else {
+        queueDecode(image, true);
+        misses.add();
+    }
+    hitRatio.set(hits.value() * 100 / (hits.value() + misses.value()));
+
+    // Prefetching more than the cache holds would evict frames before they are shown
+    auto ahead = static_cast<size_t>(std::max(0, settings.prefetchFrames));
+    if (!cache.empty()) {
+        auto cacheFrames = cacheBudget / frameBytes(cache.at(lru.front()).frame);
+        ahead = std::min(ahead, cacheFrames > 0 ? cacheFrames - 1 : 0);
+    }
+    for (size_t i = 1; i <= ahead && i < count; i++) {
+        auto next = (image + i) % count;
+        if (cache.find(next) == cache.end()) {
+            queueDecode(next, false);
+        }
+    }
+    return frame;
+}
+
+otk_thread_func_return_type ImageSequenceSource::decoder_thread_start_function(void *arg) {
+    auto _this = static_cast<ImageSequenceSource *>(arg);
+    if (_this == nullptr) {
+        otk_thread_func_return_value;
+    }
+
+    Trace::setThreadName("image-decoder");
+    CpuAttachment cpuAttachment(_this->cpuAccount);
+
+    // Reused for every file this thread reads
+    std::vector<uint8_t> file;
+    while (true) {
+        size_t image;
+        {
+            std::unique_lock lock(_this->mutex);
+            _this->decodeQueued.wait(lock, [_this]() {
+                return _this->exitDecoders || !_this->queue.empty();
+            });
+            if (_this->exitDecoders) {
+                break;
+            }
+            image = _this->queue.front();
+            _this->queue.pop_front();
+        }
+        _this->decode(image, file);
+    }
+
+    otk_thread_func_return_value;
+}
+
+void ImageSequenceSource::decode(size_t image, std::vector<uint8_t> &file) {
+    TRACE_SCOPE("decode_image");
+    auto start = std::chrono::steady_clock::now();
+    VideoFrame frame;
+    if (readFile(paths[image], file)) {
+        frame = decodeImage(file.data(), file.size(), *pool);
+    }
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    std::lock_guard lock(mutex);
+    pending.erase(image);
+    if (!frame.buffer) {
+        decodeErrors.add();
+        failed[image] = true;
+        failedCount++;
+        logger.warn("{}: could not read or decode {}, skipping it", __FUNCTION__, paths[image]);
+        if (failedCount == paths.size()) {
+            logger.error("{}: no image in {} can be decoded", __FUNCTION__, settings.directory);
+        }
+        return;
+    }
+    decodes.add();
+    if (decoded[image]) {
+        redecodes.add();
+    }
+    decoded[image] = true;
+    decodeMicros.add(micros.count());
+    frame.index = image;
+    insert(image, std::move(frame));
+}
+
+void ImageSequenceSource::queueDecode(size_t image, bool urgent) {
+    if (failed[image]) {
+        return;
+    }
+    if (pending.count(image) > 0) {
+        // A frame that is already late goes ahead of the prefetched ones
+        auto queued = std::find(queue.begin(), queue.end(), image);
+        if (urgent && queued != queue.end() && queued != queue.begin()) {
+            queue.erase(queued);
+            queue.push_front(image);
+        }
+        return;
+    }
+    pending.insert(image);
+    if (urgent) {
+        queue.push_front(image);
+    } else {
+        queue.push_back(image);
+    }
+    decodeQueued.notify_one();
+}
+
+void ImageSequenceSource::insert(size_t image, VideoFrame frame) {
+    cacheBytes += frameBytes(frame);
+    lru.push_front(image);
+    cache.emplace(image, CacheEntry{std::move(frame), lru.begin()});
+
+    // The newest frame stays even if it alone is over budget
+    while (cacheBytes > cacheBudget && lru.size() > 1) {
+        auto evicted = cache.find(lru.back());
+        cacheBytes -= frameBytes(evicted->second.frame);
+        cache.erase(evicted);
+        lru.pop_back();
+        evictions.add();
+    }
+    // Buffers kept for reuse count against the cache budget, so evicted frames do not pile up in the pool
+    pool->setMaxFreeBytes(cacheBudget > cacheBytes ? cacheBudget - cacheBytes : 0);
+    updateMemoryMetrics();
+}
+
+void ImageSequenceSource::updateMemoryMetrics() {
+    cachedFrames.set(static_cast<int64_t>(cache.size()));
+    cachedBytes.set(static_cast<int64_t>(cacheBytes));
+    poolBytes.set(static_cast<int64_t>(pool->allocatedBytes()));
+}
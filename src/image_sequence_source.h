@@ -0,0 +1,155 @@
+#ifndef IMAGE_SEQUENCE_SOURCE_H
+#define IMAGE_SEQUENCE_SOURCE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "cpu_governor.h"
+#include "frame_pool.h"
+#include "logger.h"
+#include "metrics.h"
+#include "otk_thread.h"
+
+struct ImageSequenceSettings {
+    // Directory of .ppm and .qoi images, played in name order and looped. Empty disables the image source
+    std::string directory;
+    // Decoded frames kept in the cache, at 4 bytes per pixel
+    int cacheMb = 256;
+    // Images decoded ahead of the one being published
+    int prefetchFrames = 8;
+    int decodeThreads = 2;
+    // How long each image is shown, 0 shows the next image in every frame
+    int frameDurationMs = 0;
+};
+
+/**
+ * Plays a directory of images as a looping sequence of ARGB32 frames.
+ *
+ * Images are decoded by a pool of background workers into an LRU cache bounded by cacheMb. Asking for a frame
+ * queues the next prefetchFrames images, so the publisher normally finds its frame decoded, and once a sequence that
+ * fits the cache has looped once no image is decoded again. A frame that is not ready yet is a miss: it is decoded
+ * first and the publisher skips that slot rather than wait. Cache hits and misses, decode time and the memory held by
+ * the cache and its buffer pool are reported as images.* metrics. A sequence longer than the cache holds still hits
+ * when prefetching keeps up, so images decoded again after being evicted are counted as redecodes. Buffers the pool
+ * keeps for reuse count against cacheMb as well.
+ *
+ * Several publishers may share one source, each at its own position in the sequence.
+ */
+class ImageSequenceSource {
+public:
+    /**
+     * Throws std::invalid_argument if the directory cannot be read or holds no images.
+     */
+    explicit ImageSequenceSource(ImageSequenceSettings settings);
+
+    ~ImageSequenceSource();
+
+    ImageSequenceSource(const ImageSequenceSource &) = delete;
+
+    ImageSequenceSource &operator=(const ImageSequenceSource &) = delete;
+
+    /**
+     * Accounts the decoder threads' CPU time. Must be called before start().
+     */
+    void setCpuAccount(std::shared_ptr<CpuAccount> account) {
+        cpuAccount = std::move(account);
+    }
+
+    bool start();
+
+    void stop();
+
+    [[nodiscard]] size_t imageCount() const {
+        return paths.size();
+    }
+
+    /**
+     * Size of the first image with a readable header, which publishers advertise as their capture size. Later images
+     * may differ, each frame goes out at its image's own size.
+     */
+    [[nodiscard]] int width() const {
+        return width_;
+    }
+
+    [[nodiscard]] int height() const {
+        return height_;
+    }
+
+    [[nodiscard]] std::chrono::milliseconds frameDuration() const {
+        return std::chrono::milliseconds(settings.frameDurationMs);
+    }
+
+    /**
+     * The frame at position index of the looped sequence, skipping images that failed to decode. Its index is the
+     * position actually returned, so the caller can continue after it. The buffer is empty if the image has not been
+     * decoded yet or no image in the sequence can be decoded.
+     */
+    VideoFrame frame(uint64_t index);
+
+private:
+    struct CacheEntry {
+        VideoFrame frame;
+        std::list<size_t>::iterator lru;
+    };
+
+    static otk_thread_func_return_type decoder_thread_start_function(void *arg);
+
+    void decode(size_t image, std::vector<uint8_t> &file);
+
+    void queueDecode(size_t image, bool urgent);
+
+    void insert(size_t image, VideoFrame frame);
+
+    void updateMemoryMetrics();
+
+    ImageSequenceSettings settings;
+    size_t cacheBudget;
+    std::vector<std::string> paths;
+    int width_{0};
+    int height_{0};
+
+    std::shared_ptr<FramePool> pool{FramePool::create()};
+
+    std::mutex mutex;
+    std::condition_variable decodeQueued;
+    std::deque<size_t> queue;
+    // Images queued or being decoded, so they are not queued twice
+    std::unordered_set<size_t> pending;
+    std::vector<bool> failed;
+    // Images decoded at least once, decoding one again means it was evicted
+    std::vector<bool> decoded;
+    size_t failedCount{0};
+    std::unordered_map<size_t, CacheEntry> cache;
+    // Cached images, most recently used first
+    std::list<size_t> lru;
+    size_t cacheBytes{0};
+    bool exitDecoders{false};
+
+    std::vector<otk_thread_t> decoders;
+    std::shared_ptr<CpuAccount> cpuAccount;
+
+    Metric &hits;
+    Metric &misses;
+    Metric &hitRatio;
+    Metric &decodes;
+    Metric &decodeMicros;
+    Metric &decodeErrors;
+    Metric &redecodes;
+    Metric &evictions;
+    Metric &cachedFrames;
+    Metric &cachedBytes;
+    Metric &poolBytes;
+
+    Logger logger{"ImageSequenceSource"};
+};
+
+#endif // IMAGE_SEQUENCE_SOURCE_H
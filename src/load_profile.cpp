@@ -0,0 +1,149 @@
+#include "load_profile.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr int blockShift = 4; // 16x16 blocks, the macroblock size of the encoders we feed
+constexpr int maxPanStep = 48;
+constexpr uint32_t opaque = 0xFF000000u;
+
+uint64_t hash(uint64_t seed, uint64_t a, uint64_t b) {
+    uint64_t state = seed ^ (a * 0xD6E8FEB86659FD93ull) ^ (b * 0xA0761D6478BD642Full);
+    return Xoshiro256::splitmix64(state);
+}
+
+}
+
+Xoshiro256::Xoshiro256(uint64_t seed) {
+    for (auto &word: state) {
+        word = splitmix64(seed);
+    }
+}
+
+std::optional<ContentComplexity> parseContentComplexity(std::string_view name) {
+    if (name == "static") {
+        return ContentComplexity::Static;
+    }
+    if (name == "low-motion") {
+        return ContentComplexity::LowMotion;
+    }
+    if (name == "high-motion") {
+        return ContentComplexity::HighMotion;
+    }
+    if (name == "noise") {
+        return ContentComplexity::Noise;
+    }
+    return std::nullopt;
+}
+
+const char *toString(ContentComplexity complexity) {
+    switch (complexity) {
+        case ContentComplexity::Static:
+            return "static";
+        case ContentComplexity::LowMotion:
+            return "low-motion";
+        case ContentComplexity::HighMotion:
+            return "high-motion";
+        case ContentComplexity::Noise:
+            return "noise";
+    }
+    return "unknown";
+}
+
+LoadProfile::LoadProfile(ContentComplexity complexity, uint64_t seed, int width, int height)
+        : complexity_(complexity), seed(seed), width(width), height(height), random(seed) {
+    boxSize = std::max(1 << blockShift, height / 8);
+    boxX = random.nextInt(0, std::max(0, width - boxSize));
+    boxY = random.nextInt(0, std::max(0, height - boxSize));
+    boxVelocityX = random.nextInt(1, 4);
+    boxVelocityY = random.nextInt(1, 4);
+}
+
+void LoadProfile::beginFrame() {
+    frameIndex = nextFrameIndex++;
+
+    switch (complexity_) {
+        case ContentComplexity::Static:
+        case ContentComplexity::Noise:
+            return;
+        case ContentComplexity::HighMotion:
+            panX += random.nextInt(-maxPanStep, maxPanStep);
+            panY += random.nextInt(-maxPanStep, maxPanStep);
+            break;
+        case ContentComplexity::LowMotion:
+            break;
+    }
+
+    auto moveBox = [](int &position, int &velocity, int limit) {
+        position += velocity;
+        if (position < 0 || position > limit) {
+            velocity = -velocity;
+            position = std::clamp(position, 0, std::max(0, limit));
+        }
+    };
+    auto steps = complexity_ == ContentComplexity::HighMotion ? 8 : 1;
+    for (int i = 0; i < steps; i++) {
+        moveBox(boxX, boxVelocityX, width - boxSize);
+        moveBox(boxY, boxVelocityY, height - boxSize);
+    }
+}
+
+void LoadProfile::renderStripe(uint8_t *rows, int firstRow, int rowCount) const {
+    auto pixels = reinterpret_cast<uint32_t *>(rows);
+
+    for (int y = firstRow; y < firstRow + rowCount; y++) {
+        auto row = pixels + static_cast<size_t>(y - firstRow) * width;
+
+        switch (complexity_) {
+            case ContentComplexity::Static:
+                renderBlocks(row, y, 0, 0, false);
+                continue;
+            case ContentComplexity::LowMotion:
+                renderBlocks(row, y, 0, 0, false);
+                break;
+            case ContentComplexity::HighMotion:
+                renderBlocks(row, y, panX, panY, true);
+                break;
+            case ContentComplexity::Noise: {
+                // Seeded per row, so the picture does not depend on how the frame is split into stripes
+                Xoshiro256 rowRandom(hash(seed, frameIndex, static_cast<uint64_t>(y)));
+                int x = 0;
+                for (; x + 1 < width; x += 2) {
+                    auto value = rowRandom.next();
+                    row[x] = opaque | static_cast<uint32_t>(value);
+                    row[x + 1] = opaque | static_cast<uint32_t>(value >> 32);
+                }
+                if (x < width) {
+                    row[x] = opaque | static_cast<uint32_t>(rowRandom.next());
+                }
+                continue;
+            }
+        }
+
+        if (y >= boxY && y < boxY + boxSize) {
+            auto color = opaque | static_cast<uint32_t>(hash(seed, ~0ull, ~0ull));
+            std::fill(row + boxX, row + std::min(width, boxX + boxSize), color);
+        }
+    }
+}
+
+void LoadProfile::renderBlocks(uint32_t *row, int y, int offsetX, int offsetY, bool animated) const {
+    auto blockY = (y + offsetY) >> blockShift;
+    int x = 0;
+    while (x < width) {
+        auto blockX = (x + offsetX) >> blockShift;
+        auto blockEnd = std::min(width, ((blockX + 1) << blockShift) - offsetX);
+        std::fill(row + x, row + blockEnd, blockColor(blockX, blockY, animated));
+        x = blockEnd;
+    }
+}
+
+uint32_t LoadProfile::blockColor(int blockX, int blockY, bool animated) const {
+    auto value = hash(seed, static_cast<uint64_t>(blockX), static_cast<uint64_t>(blockY));
+    if (animated) {
+        // Blocks change colour every 1, 2, 4 or 8 frames
+        value = hash(value, frameIndex >> (value & 3), 0);
+    }
+    return opaque | static_cast<uint32_t>(value);
+}
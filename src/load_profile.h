@@ -0,0 +1,118 @@
+#ifndef LOAD_PROFILE_H
+#define LOAD_PROFILE_H
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+/**
+ * xoshiro256** by Blackman and Vigna, seeded through splitmix64. Small, fast and reproducible on every platform,
+ * unlike std::random_device.
+ */
+class Xoshiro256 {
+public:
+    explicit Xoshiro256(uint64_t seed);
+
+    uint64_t next() {
+        auto result = rotl(state[1] * 5, 7) * 9;
+        auto t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    /**
+     * Uniform integer in [low, high].
+     */
+    int nextInt(int low, int high) {
+        auto range = static_cast<uint64_t>(high - low) + 1;
+        return low + static_cast<int>(((next() >> 32) * range) >> 32);
+    }
+
+    static uint64_t splitmix64(uint64_t &state) {
+        auto z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+private:
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t state[4]{};
+};
+
+enum class ContentComplexity {
+    // One fixed picture, only the first frame costs anything to encode
+    Static,
+    // Fixed background with a small box drifting across it
+    LowMotion,
+    // Background pans in random jumps and blocks change colour every few frames
+    HighMotion,
+    // Every pixel random every frame, nothing for the encoder to predict
+    Noise
+};
+
+std::optional<ContentComplexity> parseContentComplexity(std::string_view name);
+
+const char *toString(ContentComplexity complexity);
+
+/**
+ * Deterministic synthetic content for encoder stress tests.
+ *
+ * The same seed and complexity produce the same frame sequence on every host and build, independent of how the
+ * frame is split into stripes or how many threads render it. beginFrame() advances the per-stream generator once per
+ * frame, after which renderStripe() may run concurrently for disjoint stripes.
+ */
+class LoadProfile {
+public:
+    LoadProfile(ContentComplexity complexity, uint64_t seed, int width, int height);
+
+    [[nodiscard]] ContentComplexity complexity() const {
+        return complexity_;
+    }
+
+    /**
+     * Switches the content from the next frame on, carrying on with the same generator rather than starting the
+     * sequence over.
+     */
+    void setComplexity(ContentComplexity complexity) {
+        complexity_ = complexity;
+    }
+
+    void beginFrame();
+
+    /**
+     * Writes rowCount ARGB32 rows starting at firstRow. rows points at the first byte of firstRow.
+     */
+    void renderStripe(uint8_t *rows, int firstRow, int rowCount) const;
+
+private:
+    void renderBlocks(uint32_t *row, int y, int offsetX, int offsetY, bool animated) const;
+
+    [[nodiscard]] uint32_t blockColor(int blockX, int blockY, bool animated) const;
+
+    ContentComplexity complexity_;
+    uint64_t seed;
+    int width;
+    int height;
+
+    Xoshiro256 random;
+    uint64_t nextFrameIndex{0};
+    uint64_t frameIndex{0};
+    int panX{0};
+    int panY{0};
+    int boxSize{0};
+    int boxX{0};
+    int boxY{0};
+    int boxVelocityX{0};
+    int boxVelocityY{0};
+};
+
+#endif // LOAD_PROFILE_H
@@ -0,0 +1,83 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <ctime>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "fmt/format.h"
+
+enum class LogLevel {
+    Debug,
+    Info,
+    Warning,
+    Error
+};
+
+class Logger {
+public:
+    explicit Logger(std::string tag, LogLevel logLevel = LogLevel::Debug) : tag(std::move(tag)), logLevel(logLevel) {}
+
+    void setLogLevel(LogLevel level) {
+        logLevel = level;
+    }
+
+    template<typename... Args>
+    void log(LogLevel level, const std::string &format, const Args &... args) {
+        if (level >= logLevel) {
+            std::string logString = fmt::format(format, args...);
+            outputLog(level, logString);
+        }
+    }
+
+    template<typename... Args>
+    void debug(const std::string &format, const Args &... args) {
+        log(LogLevel::Debug, format, args...);
+    }
+
+    template<typename... Args>
+    void warn(const std::string &format, const Args &... args) {
+        log(LogLevel::Warning, format, args...);
+    }
+
+    template<typename... Args>
+    void error(const std::string &format, const Args &... args) {
+        log(LogLevel::Error, format, args...);
+    }
+
+private:
+    std::string tag;
+    LogLevel logLevel;
+
+    void outputLog(LogLevel level, const std::string &logString) {
+        std::string levelString;
+        switch (level) {
+            case LogLevel::Debug:
+                levelString = "DEBUG";
+                break;
+            case LogLevel::Info:
+                levelString = "INFO";
+                break;
+            case LogLevel::Warning:
+                levelString = "WARNING";
+                break;
+            case LogLevel::Error:
+                levelString = "ERROR";
+                break;
+        }
+
+        std::cout << utcTime() << " [" << levelString << "] " << "(" << tag << ") " << logString << std::endl;
+    }
+
+    static std::string utcTime() {
+        std::time_t time = std::time({});
+        char timeString[std::size("yyyy-mm-ddThh:mm:ss.SSSZ")];
+        std::strftime(std::data(timeString), std::size(timeString),
+                      "%FT%TZ", std::gmtime(&time));
+        std::stringstream ss;
+        ss << timeString;
+        return ss.str();
+    }
+};
+
+#endif // LOGGER_H
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <atomic>
 #include <iostream>
 #include <opentok.h>
@@ -5,109 +6,241 @@
 #include <ctime>
 #include <dotenv.h>
 #include <sstream>
-#include <random>
 #include <thread>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <vector>
 #include <condition_variable>
+#include <csignal>
+#include <stdexcept>
 #include "fmt/format.h"
+#include "audio_renderer.h"
+#include "backpressure.h"
+#include "cpu_governor.h"
+#include "load_profile.h"
+#include "logger.h"
+#include "metrics.h"
 #include "otk_thread.h"
+#include "image_sequence_source.h"
+#include "simulcast_source.h"
+#include "soak_monitor.h"
+#include "stream_recorder.h"
+#include "stripe_renderer.h"
+#include "trace.h"
 
-enum class LogLevel {
-    Debug,
-    Info,
-    Warning,
-    Error
+constexpr auto API_KEY_ENV = "API_KEY";
+constexpr auto SESSION_ID_ENV = "SESSION_ID";
+constexpr auto TOKEN_ENV = "TOKEN";
+constexpr auto VIDEO_WIDTH_ENV = "VIDEO_WIDTH";
+constexpr auto VIDEO_HEIGHT_ENV = "VIDEO_HEIGHT";
+constexpr auto VIDEO_FPS_ENV = "VIDEO_FPS";
+constexpr auto VIDEO_LAYERS_ENV = "VIDEO_LAYERS";
+constexpr auto VIDEO_PUBLISHERS_ENV = "VIDEO_PUBLISHERS";
+constexpr auto RENDER_THREADS_ENV = "RENDER_THREADS";
+constexpr auto LOAD_PROFILE_ENV = "LOAD_PROFILE";
+constexpr auto LOAD_SEED_ENV = "LOAD_SEED";
+constexpr auto IMAGE_DIR_ENV = "IMAGE_DIR";
+constexpr auto IMAGE_CACHE_MB_ENV = "IMAGE_CACHE_MB";
+constexpr auto IMAGE_PREFETCH_ENV = "IMAGE_PREFETCH";
+constexpr auto IMAGE_DECODE_THREADS_ENV = "IMAGE_DECODE_THREADS";
+constexpr auto IMAGE_DURATION_MS_ENV = "IMAGE_DURATION_MS";
+constexpr auto AUDIO_SINK_ENV = "AUDIO_SINK";
+constexpr auto AUDIO_JITTER_MS_ENV = "AUDIO_JITTER_MS";
+constexpr auto RECORD_DIR_ENV = "RECORD_DIR";
+constexpr auto RECORD_FORMAT_ENV = "RECORD_FORMAT";
+constexpr auto RECORD_SEGMENT_MB_ENV = "RECORD_SEGMENT_MB";
+constexpr auto TRACE_FILE_ENV = "TRACE_FILE";
+constexpr auto METRICS_INTERVAL_ENV = "METRICS_INTERVAL";
+constexpr auto BACKPRESSURE_POLICY_ENV = "BACKPRESSURE_POLICY";
+constexpr auto BACKPRESSURE_DEFICIT_FRAMES_ENV = "BACKPRESSURE_DEFICIT_FRAMES";
+constexpr auto BACKPRESSURE_RECOVERY_FRAMES_ENV = "BACKPRESSURE_RECOVERY_FRAMES";
+constexpr auto BACKPRESSURE_MAX_LEVEL_ENV = "BACKPRESSURE_MAX_LEVEL";
+constexpr auto CPU_BUDGET_PCT_ENV = "CPU_BUDGET_PCT";
+constexpr auto CPU_GOVERNOR_INTERVAL_MS_ENV = "CPU_GOVERNOR_INTERVAL_MS";
+constexpr auto CPU_GOVERNOR_MAX_LEVEL_ENV = "CPU_GOVERNOR_MAX_LEVEL";
+constexpr auto RUN_SECONDS_ENV = "RUN_SECONDS";
+constexpr auto SOAK_INTERVAL_ENV = "SOAK_INTERVAL";
+constexpr auto SOAK_WARMUP_ENV = "SOAK_WARMUP";
+constexpr auto SOAK_MAX_RSS_GROWTH_MB_ENV = "SOAK_MAX_RSS_GROWTH_MB";
+constexpr auto SOAK_MAX_THREAD_GROWTH_ENV = "SOAK_MAX_THREAD_GROWTH";
+constexpr auto SOAK_MAX_ALLOCATION_GROWTH_ENV = "SOAK_MAX_ALLOCATION_GROWTH";
+constexpr auto SOAK_MAX_CADENCE_ERROR_PCT_ENV = "SOAK_MAX_CADENCE_ERROR_PCT";
+constexpr auto SOAK_MAX_START_DELAY_MS_ENV = "SOAK_MAX_START_DELAY_MS";
+constexpr auto SOAK_MAX_CPU_PCT_ENV = "SOAK_MAX_CPU_PCT";
+
+const auto getApiKey = []() {
+    return std::getenv(API_KEY_ENV);
+};
+const auto getSessionId = []() {
+    return std::getenv(SESSION_ID_ENV);
+};
+const auto getToken = []() {
+    return std::getenv(TOKEN_ENV);
+};
+const auto getTraceFile = []() {
+    return std::getenv(TRACE_FILE_ENV);
+};
+const auto getIntEnv = [](const char *name, int defaultValue) {
+    auto value = std::getenv(name);
+    return value != nullptr ? std::atoi(value) : defaultValue;
 };
 
-class Logger {
-public:
-    explicit Logger(std::string tag, LogLevel logLevel = LogLevel::Debug) : tag(std::move(tag)), logLevel(logLevel) {}
+// Each degradation level halves the fps, so deeper levels would only overflow the frame interval shifts
+constexpr int maxDegradationLevel = 8;
 
-    void setLogLevel(LogLevel level) {
-        logLevel = level;
+const auto getLevelEnv = [](const char *name, int defaultValue) {
+    auto level = getIntEnv(name, defaultValue);
+    auto clamped = std::clamp(level, 0, maxDegradationLevel);
+    if (clamped != level) {
+        Logger{"Main"}.warn("{} {} is out of range, using {}", name, level, clamped);
     }
+    return clamped;
+};
 
-    template<typename... Args>
-    void log(LogLevel level, const std::string &format, const Args &... args) {
-        if (level >= logLevel) {
-            std::string logString = fmt::format(format, args...);
-            outputLog(level, logString);
-        }
-    }
+struct VideoSettings {
+    std::string name = "opentok-encoder-demo";
+    int width = 1280;
+    int height = 720;
+    int fps = 1;
+    // 0 renders on one thread per hardware core
+    int renderThreads = 1;
+    ContentComplexity complexity = ContentComplexity::LowMotion;
+    uint64_t seed = 1;
+    BackpressureSettings backpressure;
+    CpuGovernorSettings cpuGovernor;
+    // When set, one source is rendered at the first size and published once per layer
+    std::vector<LayerSize> layers;
+    // Independent publishers, each rendering its own stream, for scale runs
+    int publishers = 1;
+    // When a directory is set, publishers play its images instead of rendering
+    ImageSequenceSettings imageSequence;
+};
 
-    template<typename... Args>
-    void debug(const std::string &format, const Args &... args) {
-        log(LogLevel::Debug, format, args...);
-    }
+struct AudioSettings {
+    // null, file:<path> or shm:<name>
+    std::string sink = "null";
+    int jitterBufferMs = 60;
+};
 
-    template<typename... Args>
-    void warn(const std::string &format, const Args &... args) {
-        log(LogLevel::Warning, format, args...);
+const auto getAudioSettings = []() {
+    AudioSettings settings;
+    if (auto sink = std::getenv(AUDIO_SINK_ENV)) {
+        settings.sink = sink;
     }
+    settings.jitterBufferMs = getIntEnv(AUDIO_JITTER_MS_ENV, settings.jitterBufferMs);
+    return settings;
+};
 
-    template<typename... Args>
-    void error(const std::string &format, const Args &... args) {
-        log(LogLevel::Error, format, args...);
-    }
+struct RecordingSettings {
+    // Empty disables subscribing and recording
+    std::string directory;
+    RecordingFormat format = RecordingFormat::Y4m;
+    int segmentMb = 512;
+    // Frame rate written to the Y4M header, received frames are stored as they arrive
+    int fps = 30;
+};
 
-private:
-    std::string tag;
-    LogLevel logLevel;
-
-    void outputLog(LogLevel level, const std::string &logString) {
-        std::string levelString;
-        switch (level) {
-            case LogLevel::Debug:
-                levelString = "DEBUG";
-                break;
-            case LogLevel::Info:
-                levelString = "INFO";
-                break;
-            case LogLevel::Warning:
-                levelString = "WARNING";
-                break;
-            case LogLevel::Error:
-                levelString = "ERROR";
-                break;
-        }
-
-        std::cout << utcTime() << " [" << levelString << "] " << "(" << tag << ") " << logString << std::endl;
-    }
-
-    static std::string utcTime() {
-        std::time_t time = std::time({});
-        char timeString[std::size("yyyy-mm-ddThh:mm:ss.SSSZ")];
-        std::strftime(std::data(timeString), std::size(timeString),
-                      "%FT%TZ", std::gmtime(&time));
-        std::stringstream ss;
-        ss << timeString;
-        return ss.str();
+const auto getRecordingSettings = []() {
+    RecordingSettings settings;
+    if (auto directory = std::getenv(RECORD_DIR_ENV)) {
+        settings.directory = directory;
+    }
+    if (auto formatName = std::getenv(RECORD_FORMAT_ENV)) {
+        if (auto format = parseRecordingFormat(formatName)) {
+            settings.format = *format;
+        } else {
+            Logger{"Main"}.warn("Unknown {} '{}', using y4m", RECORD_FORMAT_ENV, formatName);
+        }
     }
+    settings.segmentMb = std::max(1, getIntEnv(RECORD_SEGMENT_MB_ENV, settings.segmentMb));
+    return settings;
 };
 
-constexpr auto API_KEY_ENV = "API_KEY";
-constexpr auto SESSION_ID_ENV = "SESSION_ID";
-constexpr auto TOKEN_ENV = "TOKEN";
-
-const auto getApiKey = []() {
-    return std::getenv(API_KEY_ENV);
-};
-const auto getSessionId = []() {
-    return std::getenv(SESSION_ID_ENV);
+const auto getSoakBudgets = []() {
+    SoakBudgets budgets;
+    budgets.maxRssGrowthKb = static_cast<int64_t>(getIntEnv(SOAK_MAX_RSS_GROWTH_MB_ENV,
+                                                            static_cast<int>(budgets.maxRssGrowthKb / 1024))) * 1024;
+    budgets.maxThreadGrowth = getIntEnv(SOAK_MAX_THREAD_GROWTH_ENV, static_cast<int>(budgets.maxThreadGrowth));
+    budgets.maxLiveAllocationGrowth = getIntEnv(SOAK_MAX_ALLOCATION_GROWTH_ENV,
+                                                static_cast<int>(budgets.maxLiveAllocationGrowth));
+    budgets.maxCadenceErrorPercent = getIntEnv(SOAK_MAX_CADENCE_ERROR_PCT_ENV, budgets.maxCadenceErrorPercent);
+    budgets.maxStartDelayMs = getIntEnv(SOAK_MAX_START_DELAY_MS_ENV, budgets.maxStartDelayMs);
+    budgets.maxCpuPercent = getIntEnv(SOAK_MAX_CPU_PCT_ENV, budgets.maxCpuPercent);
+    return budgets;
 };
-const auto getToken = []() {
-    return std::getenv(TOKEN_ENV);
+
+const auto getVideoSettings = []() {
+    VideoSettings settings;
+    settings.width = getIntEnv(VIDEO_WIDTH_ENV, settings.width);
+    settings.height = getIntEnv(VIDEO_HEIGHT_ENV, settings.height);
+    settings.fps = getIntEnv(VIDEO_FPS_ENV, settings.fps);
+    settings.renderThreads = getIntEnv(RENDER_THREADS_ENV, settings.renderThreads);
+    settings.publishers = std::max(1, getIntEnv(VIDEO_PUBLISHERS_ENV, settings.publishers));
+    if (auto layers = std::getenv(VIDEO_LAYERS_ENV)) {
+        settings.layers = parseLayerSizes(layers);
+        if (settings.layers.empty()) {
+            Logger{"Main"}.warn("Invalid {} '{}', publishing a single stream", VIDEO_LAYERS_ENV, layers);
+        }
+    }
+    if (auto directory = std::getenv(IMAGE_DIR_ENV)) {
+        settings.imageSequence.directory = directory;
+    }
+    settings.imageSequence.cacheMb = getIntEnv(IMAGE_CACHE_MB_ENV, settings.imageSequence.cacheMb);
+    settings.imageSequence.prefetchFrames = getIntEnv(IMAGE_PREFETCH_ENV, settings.imageSequence.prefetchFrames);
+    settings.imageSequence.decodeThreads = getIntEnv(IMAGE_DECODE_THREADS_ENV, settings.imageSequence.decodeThreads);
+    settings.imageSequence.frameDurationMs = getIntEnv(IMAGE_DURATION_MS_ENV,
+                                                       settings.imageSequence.frameDurationMs);
+    if (auto profile = std::getenv(LOAD_PROFILE_ENV)) {
+        if (auto complexity = parseContentComplexity(profile)) {
+            settings.complexity = *complexity;
+        } else {
+            Logger{"Main"}.warn("Unknown {} '{}', using {}", LOAD_PROFILE_ENV, profile, toString(settings.complexity));
+        }
+    }
+    if (auto seed = std::getenv(LOAD_SEED_ENV)) {
+        settings.seed = std::strtoull(seed, nullptr, 10);
+    }
+    if (auto policyName = std::getenv(BACKPRESSURE_POLICY_ENV)) {
+        if (auto policy = parseBackpressurePolicy(policyName)) {
+            settings.backpressure.policy = *policy;
+        } else {
+            Logger{"Main"}.warn("Unknown {} '{}', using {}", BACKPRESSURE_POLICY_ENV, policyName,
+                                toString(settings.backpressure.policy));
+        }
+    }
+    settings.backpressure.deficitFrames = getIntEnv(BACKPRESSURE_DEFICIT_FRAMES_ENV,
+                                                    settings.backpressure.deficitFrames);
+    settings.backpressure.recoveryFrames = getIntEnv(BACKPRESSURE_RECOVERY_FRAMES_ENV,
+                                                     settings.backpressure.recoveryFrames);
+    settings.backpressure.maxLevel = getLevelEnv(BACKPRESSURE_MAX_LEVEL_ENV, settings.backpressure.maxLevel);
+    settings.cpuGovernor.budgetPercent = getIntEnv(CPU_BUDGET_PCT_ENV, settings.cpuGovernor.budgetPercent);
+    settings.cpuGovernor.interval = std::chrono::milliseconds(
+            getIntEnv(CPU_GOVERNOR_INTERVAL_MS_ENV, static_cast<int>(settings.cpuGovernor.interval.count())));
+    settings.cpuGovernor.maxLevel = getLevelEnv(CPU_GOVERNOR_MAX_LEVEL_ENV, settings.cpuGovernor.maxLevel);
+    return settings;
 };
 
 class OpenTokAudioPublisher {
 public:
-    OpenTokAudioPublisher() = default;
+    explicit OpenTokAudioPublisher(AudioSettings settings) : settings(std::move(settings)) {}
+
+    /**
+     * Accounts the capturer and renderer threads' CPU time. Must be called before the session connects.
+     */
+    void setCpuAccount(std::shared_ptr<CpuAccount> account) {
+        cpuAccount = std::move(account);
+    }
 
     bool initialize() {
         struct otc_audio_device_callbacks audioDeviceCallbacks = {
                 .destroy_capturer = &audio_device_destroy_capturer,
                 .start_capturer = &audio_device_start_capturer,
                 .get_capture_settings = &audio_device_get_capture_settings,
+                .destroy_renderer = &audio_device_destroy_renderer,
+                .start_renderer = &audio_device_start_renderer,
+                .stop_renderer = &audio_device_stop_renderer,
+                .get_render_settings = &audio_device_get_render_settings,
                 .user_data = this,
         };
 
@@ -126,6 +259,8 @@ private:
         }
 
         _this->logger.debug(__FUNCTION__);
+        Trace::setThreadName("audio-capturer");
+        CpuAttachment cpuAttachment(_this->cpuAccount);
 
         int16_t samples[480];
         static double time = 0;
@@ -137,7 +272,11 @@ private:
                 samples[i] = (int16_t)val;
                 time += 10.0 / 480.0;
             }
-            otc_audio_device_write_capture_data(samples, 480);
+            {
+                TRACE_SCOPE("otc_audio_device_write_capture_data");
+                otc_audio_device_write_capture_data(samples, 480);
+            }
+            TRACE_SCOPE("sleep");
             usleep(10 * 1000);
         }
         _this->isPublishing_ = false;
@@ -147,6 +286,7 @@ private:
 
     static otc_bool audio_device_destroy_capturer(const otc_audio_device *audio_device,
                                                   void *user_data) {
+        TRACE_SCOPE(__FUNCTION__);
         auto _this = static_cast<OpenTokAudioPublisher *>(user_data);
         if (_this == nullptr) {
             return OTC_FALSE;
@@ -162,6 +302,7 @@ private:
 
     static otc_bool audio_device_start_capturer(const otc_audio_device *audio_device,
                                                 void *user_data) {
+        TRACE_SCOPE(__FUNCTION__);
         auto _this = static_cast<OpenTokAudioPublisher *>(user_data);
         if (_this == nullptr) {
             return OTC_FALSE;
@@ -180,6 +321,7 @@ private:
     static otc_bool audio_device_get_capture_settings(const otc_audio_device *audio_device,
                                                       void *user_data,
                                                       struct otc_audio_device_settings *settings) {
+        TRACE_SCOPE(__FUNCTION__);
         if (settings == nullptr) {
             return OTC_FALSE;
         }
@@ -189,9 +331,89 @@ private:
         return OTC_TRUE;
     }
 
+    /**
+     * Audio Renderer Callbacks
+     */
+
+    static otc_bool audio_device_destroy_renderer(const otc_audio_device *audio_device,
+                                                  void *user_data) {
+        TRACE_SCOPE(__FUNCTION__);
+        auto _this = static_cast<OpenTokAudioPublisher *>(user_data);
+        if (_this == nullptr) {
+            return OTC_FALSE;
+        }
+
+        _this->logger.debug(__FUNCTION__);
+
+        _this->audioRenderer.reset();
+
+        return OTC_TRUE;
+    }
+
+    static otc_bool audio_device_start_renderer(const otc_audio_device *audio_device,
+                                                void *user_data) {
+        TRACE_SCOPE(__FUNCTION__);
+        auto _this = static_cast<OpenTokAudioPublisher *>(user_data);
+        if (_this == nullptr) {
+            return OTC_FALSE;
+        }
+
+        _this->logger.debug(__FUNCTION__);
+
+        if (!_this->audioRenderer) {
+            auto sink = createAudioSink(_this->settings.sink, AudioRenderer::samplingRate, 1);
+            if (!sink) {
+                _this->logger.error("{}: could not open audio sink '{}'", __FUNCTION__, _this->settings.sink);
+                return OTC_FALSE;
+            }
+            _this->audioRenderer = std::make_unique<AudioRenderer>(std::move(sink), _this->settings.jitterBufferMs);
+            _this->audioRenderer->setCpuAccount(_this->cpuAccount);
+        }
+        if (!_this->audioRenderer->start()) {
+            return OTC_FALSE;
+        }
+
+        return OTC_TRUE;
+    }
+
+    static otc_bool audio_device_stop_renderer(const otc_audio_device *audio_device,
+                                               void *user_data) {
+        TRACE_SCOPE(__FUNCTION__);
+        auto _this = static_cast<OpenTokAudioPublisher *>(user_data);
+        if (_this == nullptr) {
+            return OTC_FALSE;
+        }
+
+        _this->logger.debug(__FUNCTION__);
+
+        // Kept for a later start_renderer, destroy_renderer releases it
+        if (_this->audioRenderer) {
+            _this->audioRenderer->stop();
+        }
+
+        return OTC_TRUE;
+    }
+
+    static otc_bool audio_device_get_render_settings(const otc_audio_device *audio_device,
+                                                     void *user_data,
+                                                     struct otc_audio_device_settings *settings) {
+        TRACE_SCOPE(__FUNCTION__);
+        if (settings == nullptr) {
+            return OTC_FALSE;
+        }
+
+        settings->number_of_channels = 1;
+        settings->sampling_rate = AudioRenderer::samplingRate;
+        return OTC_TRUE;
+    }
+
 
     Logger logger{"OpenTokPublisher"};
 
+    AudioSettings settings;
+    std::unique_ptr<AudioRenderer> audioRenderer;
+    std::shared_ptr<CpuAccount> cpuAccount;
+
     otk_thread_t audioCapturerThread{};
     std::atomic<bool> exitAudioCapturerThread{false};
 
@@ -200,7 +422,16 @@ private:
 
 class OpenTokVideoPublisher {
 public:
-    OpenTokVideoPublisher() = default;
+    explicit OpenTokVideoPublisher(const VideoSettings &settings) : name(settings.name),
+                                                                    width(settings.width), height(settings.height),
+                                                                    fps(std::max(1, settings.fps)),
+                                                                    renderThreads(
+                                                                            settings.renderThreads > 0
+                                                                            ? settings.renderThreads
+                                                                            : StripeRenderer::defaultThreadCount()),
+                                                                    complexity(settings.complexity),
+                                                                    seed(settings.seed),
+                                                                    backpressureSettings(settings.backpressure) {}
 
     ~OpenTokVideoPublisher() {
         if (publisher) {
@@ -224,7 +455,7 @@ public:
                 .user_data = this
         };
 
-        publisher = otc_publisher_new("opentok-encoder-demo", &videoCapturerCallbacks, &publisherCallbacks);
+        publisher = otc_publisher_new(name.c_str(), &videoCapturerCallbacks, &publisherCallbacks);
         if (publisher == nullptr) {
             logger.error("OpenTokPublisher: Could not create otc publisher");
             return false;
@@ -244,6 +475,39 @@ public:
         return true;
     }
 
+    /**
+     * Publishes one layer of a shared source instead of rendering frames on the capturer thread. Must be called
+     * before the capturer starts.
+     */
+    void setSource(std::shared_ptr<SimulcastSource> layerSource, size_t sourceLayer) {
+        source = std::move(layerSource);
+        layer = sourceLayer;
+    }
+
+    /**
+     * Publishes a shared image sequence instead of rendering frames on the capturer thread. Must be called before
+     * the capturer starts.
+     */
+    void setImageSource(std::shared_ptr<ImageSequenceSource> imageSource) {
+        images = std::move(imageSource);
+    }
+
+    /**
+     * Accounts the capturer and stripe worker threads' CPU time, and applies the account's governor level when the
+     * publisher renders its own frames. Must be called before the capturer starts.
+     */
+    void setCpuAccount(std::shared_ptr<CpuAccount> account) {
+        cpuAccount = std::move(account);
+    }
+
+    [[nodiscard]] const std::string &streamName() const {
+        return name;
+    }
+
+    [[nodiscard]] int frameRate() const {
+        return fps;
+    }
+
     bool unPublishFromSession(otc_session *session) {
         if (!publisher) {
             logger.error("{}: publisher is null", __FUNCTION__);
@@ -261,13 +525,6 @@ public:
     }
 
 private:
-    static int generate_random_integer() {
-        std::random_device rd;
-        std::mt19937 mt(rd());
-        std::uniform_int_distribution dist(1, RAND_MAX);
-        return dist(mt);
-    }
-
     /**
      * Video Capturer Callbacks
      */
@@ -286,21 +543,163 @@ private:
         }
 
         _this->logger.debug(__FUNCTION__);
+        Trace::setThreadName("video-capturer");
+        CpuAttachment cpuAttachment(_this->cpuAccount);
         _this->isPublishing_ = true;
 
-        auto buffer = (uint8_t *) malloc(sizeof(uint8_t) * OpenTokVideoPublisher::width * OpenTokVideoPublisher::height * 4);
+        // Only needed when this publisher renders its own frames
+        uint8_t *buffer = nullptr;
+        if (!_this->source && !_this->images) {
+            auto frameSize = static_cast<size_t>(_this->width) * _this->height * 4;
+            buffer = (uint8_t *) malloc(sizeof(uint8_t) * frameSize);
+        }
 
-        while (!_this->exitVideoCapturerThread.load()) {
-            memset(buffer, generate_random_integer() & 0xFF, OpenTokVideoPublisher::width * OpenTokVideoPublisher::height * 4);
+        auto frameInterval = std::chrono::nanoseconds(std::chrono::seconds(1)) / _this->fps;
+        // Neither backpressure nor the CPU governor shrink frames below the minimum size
+        int maxShift = 0;
+        while ((_this->width >> (maxShift + 1)) >= minWidth && (_this->height >> (maxShift + 1)) >= minHeight) {
+            maxShift++;
+        }
+
+        BackpressureController backpressure(_this->backpressureSettings, _this->name);
+        backpressure.setFrameInterval(frameInterval);
+        if (_this->backpressureSettings.policy == BackpressurePolicy::ReduceResolution &&
+            (_this->source || _this->images)) {
+            // Layer and image sizes are fixed by the shared source
+            backpressure.setMaxLevel(0);
+        } else if (_this->backpressureSettings.policy == BackpressurePolicy::ReduceResolution) {
+            backpressure.setMaxLevel(std::min(maxShift, _this->backpressureSettings.maxLevel));
+        }
 
-            auto otcFrame = otc_video_frame_new(OTC_VIDEO_FRAME_FORMAT_ARGB32, OpenTokVideoPublisher::width, OpenTokVideoPublisher::height, buffer);
-            if (otc_video_capturer_provide_frame(_this->videoCapturer, 0, otcFrame) != OTC_SUCCESS) {
-                _this->logger.error("capturer_thread_start_function: Unable to provide frame");
+        // Rebuilt whenever backpressure or the CPU governor change the resolution or the content complexity, unused
+        // with a shared source or images
+        int frameWidth = 0;
+        int frameHeight = 0;
+        std::unique_ptr<StripeRenderer> renderer;
+        std::unique_ptr<LoadProfile> loadProfile;
+        std::vector<CpuAttachment> rendererAttachments;
+
+        // How late each frame slot starts, the soak monitor divides this by the slot count to get the mean delay
+        auto &frameStartDelay = Metrics::get(_this->name + ".frame_start_delay_us");
+        auto &frameSlots = Metrics::get(_this->name + ".frame_slots");
+
+        bool lastDelivered = true;
+        uint64_t nextSourceIndex = 0;
+        auto imagesStart = std::chrono::steady_clock::now();
+        uint64_t frameSlot = 0;
+        int fpsShift = 0;
+        auto nextFrameTime = std::chrono::steady_clock::now();
+        while (!_this->exitVideoCapturerThread.load()) {
+            auto adjustment = _this->cpuAccount ? _this->cpuAccount->adjustment() : QualityAdjustment{};
+            if (adjustment.fpsShift != fpsShift) {
+                // Frames a governed stream renders at a lower fps have that much longer to be late against
+                fpsShift = adjustment.fpsShift;
+                backpressure.setFrameInterval(frameInterval * (1 << fpsShift));
+            }
+            auto frameStart = nextFrameTime;
+            frameStartDelay.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - frameStart).count());
+            frameSlots.add();
+            if (backpressure.shouldDeliver(frameSlot++)) {
+                const uint8_t *frameBuffer = nullptr;
+                VideoFrame sourceFrame;
+                if (_this->source) {
+                    // The shared source renders the layers, pass on each of its frames once
+                    sourceFrame = _this->source->latestFrame(_this->layer);
+                    if (sourceFrame.buffer && sourceFrame.index >= nextSourceIndex) {
+                        frameBuffer = sourceFrame.buffer.get();
+                        frameWidth = sourceFrame.width;
+                        frameHeight = sourceFrame.height;
+                        nextSourceIndex = sourceFrame.index + 1;
+                    }
+                } else if (_this->images) {
+                    // Slideshows hold each image for its duration, otherwise every frame shows the next image
+                    auto duration = _this->images->frameDuration();
+                    auto imageIndex = duration.count() > 0
+                                      ? static_cast<uint64_t>((std::chrono::steady_clock::now() - imagesStart) /
+                                                              duration)
+                                      : nextSourceIndex;
+                    sourceFrame = _this->images->frame(imageIndex);
+                    if (sourceFrame.buffer) {
+                        frameBuffer = sourceFrame.buffer.get();
+                        frameWidth = sourceFrame.width;
+                        frameHeight = sourceFrame.height;
+                        nextSourceIndex = sourceFrame.index + 1;
+                    }
+                } else {
+                    auto shift = std::min(backpressure.resolutionShift() + adjustment.resolutionShift, maxShift);
+                    auto complexity = lowerComplexity(_this->complexity, adjustment.complexitySteps);
+                    if (frameWidth != _this->width >> shift || frameHeight != _this->height >> shift) {
+                        frameWidth = _this->width >> shift;
+                        frameHeight = _this->height >> shift;
+                        rendererAttachments.clear();
+                        renderer.reset();
+                        try {
+                            renderer = std::make_unique<StripeRenderer>(frameWidth, frameHeight, 4,
+                                                                        _this->renderThreads);
+                        } catch (const std::runtime_error &e) {
+                            _this->logger.warn("{}: {}, rendering on the capture thread only", __FUNCTION__,
+                                               e.what());
+                            renderer = std::make_unique<StripeRenderer>(frameWidth, frameHeight, 4, 1);
+                        }
+                        for (auto worker: renderer->workerThreads()) {
+                            rendererAttachments.emplace_back(_this->cpuAccount, worker);
+                        }
+                        loadProfile.reset();
+                    }
+                    if (!loadProfile || loadProfile->complexity() != complexity) {
+                        if (loadProfile) {
+                            loadProfile->setComplexity(complexity);
+                        } else {
+                            loadProfile = std::make_unique<LoadProfile>(complexity, _this->seed, frameWidth,
+                                                                        frameHeight);
+                        }
+                        _this->logger.debug("{}: rendering {} content (seed {}) at {}x{}@{} on {} threads in {} "
+                                            "stripes of {} rows", __FUNCTION__, toString(complexity),
+                                            _this->seed, frameWidth, frameHeight,
+                                            _this->fps / (backpressure.intervalMultiplier() << adjustment.fpsShift),
+                                            renderer->threadCount(), renderer->stripeCount(),
+                                            renderer->stripeRows());
+                    }
+
+                    TRACE_SCOPE("render");
+                    loadProfile->beginFrame();
+                    renderer->render(buffer, [&loadProfile](uint8_t *rows, int firstRow, int rowCount) {
+                        loadProfile->renderStripe(rows, firstRow, rowCount);
+                    });
+                    frameBuffer = buffer;
+                }
+
+                if (frameBuffer != nullptr) {
+                    bool delivered;
+                    {
+                        TRACE_SCOPE("otc_video_capturer_provide_frame");
+                        auto otcFrame = otc_video_frame_new(OTC_VIDEO_FRAME_FORMAT_ARGB32, frameWidth, frameHeight,
+                                                            frameBuffer);
+                        delivered = otc_video_capturer_provide_frame(_this->videoCapturer, 0, otcFrame) ==
+                                    OTC_SUCCESS;
+                        if (otcFrame != nullptr) {
+                            otc_video_frame_delete(otcFrame);
+                        }
+                    }
+                    // Failures are counted by the backpressure controller, only log when they start
+                    if (!delivered && lastDelivered) {
+                        _this->logger.error("capturer_thread_start_function: Unable to provide frame");
+                    }
+                    lastDelivered = delivered;
+
+                    backpressure.onFrameDelivered(delivered, std::chrono::steady_clock::now() - frameStart);
+                }
             }
-            if (otcFrame != nullptr) {
-                otc_video_frame_delete(otcFrame);
+
+            // Sleep to an absolute deadline so render time does not stretch the frame interval
+            nextFrameTime += frameInterval * (backpressure.intervalMultiplier() << adjustment.fpsShift);
+            auto now = std::chrono::steady_clock::now();
+            if (nextFrameTime < now) {
+                nextFrameTime = now;
             }
-            usleep(1000 / OpenTokVideoPublisher::fps * 1000);
+            TRACE_SCOPE("sleep");
+            std::this_thread::sleep_until(nextFrameTime);
         }
 
         if (buffer != nullptr) {
@@ -311,6 +710,7 @@ private:
     }
 
     static otc_bool video_capturer_init(const otc_video_capturer *capturer, void *user_data) {
+        TRACE_SCOPE(__FUNCTION__);
         auto _this = static_cast<OpenTokVideoPublisher *>(user_data);
         if (_this == nullptr) {
             return OTC_FALSE;
@@ -323,6 +723,7 @@ private:
     }
 
     static otc_bool video_capturer_start(const otc_video_capturer *capturer, void *user_data) {
+        TRACE_SCOPE(__FUNCTION__);
         auto _this = static_cast<OpenTokVideoPublisher *>(user_data);
         if (_this == nullptr) {
             return OTC_FALSE;
@@ -339,6 +740,7 @@ private:
     }
 
     static otc_bool video_capturer_destroy(const otc_video_capturer *capturer, void *user_data) {
+        TRACE_SCOPE(__FUNCTION__);
         auto _this = static_cast<OpenTokVideoPublisher *>(user_data);
         if (_this == nullptr) {
             return OTC_FALSE;
@@ -355,10 +757,17 @@ private:
     static otc_bool get_video_capturer_capture_settings(const otc_video_capturer *capturer,
                                                         void *user_data,
                                                         struct otc_video_capturer_settings *settings) {
+        TRACE_SCOPE(__FUNCTION__);
+        auto _this = static_cast<OpenTokVideoPublisher *>(user_data);
+        if (_this == nullptr) {
+            return OTC_FALSE;
+        }
+
         settings->format = OTC_VIDEO_FRAME_FORMAT_ARGB32;
-        settings->width = OpenTokVideoPublisher::width;
-        settings->height = OpenTokVideoPublisher::height;
-        settings->fps = OpenTokVideoPublisher::fps;
+        // Image frames go out at the images' own size rather than the configured one
+        settings->width = _this->images ? _this->images->width() : _this->width;
+        settings->height = _this->images ? _this->images->height() : _this->height;
+        settings->fps = _this->fps;
         settings->mirror_on_local_render = OTC_FALSE;
         settings->expected_delay = 0;
 
@@ -372,6 +781,7 @@ private:
     static void on_publisher_stream_created(otc_publisher *publisher,
                                             void *user_data,
                                             const otc_stream *stream) {
+        TRACE_SCOPE(__FUNCTION__);
         auto _this = static_cast<OpenTokVideoPublisher*>(user_data);
         _this->logger.debug(__FUNCTION__);
     }
@@ -379,6 +789,7 @@ private:
     static void on_publisher_stream_destroyed(otc_publisher *publisher,
                                               void *user_data,
                                               const otc_stream *stream) {
+        TRACE_SCOPE(__FUNCTION__);
         auto _this = static_cast<OpenTokVideoPublisher*>(user_data);
         _this->logger.debug(__FUNCTION__);
     }
@@ -387,10 +798,15 @@ private:
                                    void *user_data,
                                    const char* error_string,
                                    enum otc_publisher_error_code error_code) {
+        TRACE_SCOPE(__FUNCTION__);
         auto _this = static_cast<OpenTokVideoPublisher*>(user_data);
         _this->logger.error("{}: Publisher error. Error code: {}", __FUNCTION__, error_string);
     }
 
+    // Backpressure does not shrink frames below this
+    static constexpr int minWidth = 160;
+    static constexpr int minHeight = 90;
+
     Logger logger{"OpenTokPublisher"};
 
     otk_thread_t videoCapturerThread{};
@@ -401,33 +817,166 @@ private:
 
     std::atomic<bool> isPublishing_{false};
 
-    const static int width = 1280;
-    const static int height = 720;
-    const static int fps = 1;
+    const std::string name;
+    const int width;
+    const int height;
+    const int fps;
+    const int renderThreads;
+    const ContentComplexity complexity;
+    const uint64_t seed;
+    const BackpressureSettings backpressureSettings;
+
+    std::shared_ptr<SimulcastSource> source;
+    size_t layer{0};
+    std::shared_ptr<ImageSequenceSource> images;
+    std::shared_ptr<CpuAccount> cpuAccount;
+};
+
+class OpenTokSubscriber {
+public:
+    OpenTokSubscriber(std::string streamId, const RecordingSettings &settings)
+            : streamId(std::move(streamId)),
+              recorder(settings.directory, this->streamId, settings.format,
+                       static_cast<size_t>(settings.segmentMb) * 1024 * 1024, settings.fps) {}
+
+    ~OpenTokSubscriber() {
+        if (subscriber) {
+            otc_subscriber_delete(subscriber);
+        }
+    }
+
+    bool initialize(const otc_stream *stream) {
+        struct otc_subscriber_callbacks subscriberCallbacks = {
+                .on_connected = &on_subscriber_connected,
+                .on_render_frame = &on_subscriber_render_frame,
+                .on_error = &on_subscriber_error,
+                .user_data = this
+        };
+
+        subscriber = otc_subscriber_new(stream, &subscriberCallbacks);
+        if (subscriber == nullptr) {
+            logger.error("{}: Could not create otc subscriber for stream {}", __FUNCTION__, streamId);
+            return false;
+        }
+        return true;
+    }
+
+    bool subscribeToSession(otc_session *session) {
+        if (otc_session_subscribe(session, subscriber) != OTC_SUCCESS) {
+            logger.error("{}: could not subscribe to stream {}", __FUNCTION__, streamId);
+            return false;
+        }
+        return true;
+    }
+
+    bool unSubscribeFromSession(otc_session *session) {
+        if (otc_session_unsubscribe(session, subscriber) != OTC_SUCCESS) {
+            logger.error("{}: could not unsubscribe from stream {}", __FUNCTION__, streamId);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    /**
+     * Subscriber Callbacks
+     */
+
+    static void on_subscriber_connected(otc_subscriber *subscriber, void *user_data, const otc_stream *stream) {
+        TRACE_SCOPE(__FUNCTION__);
+        auto _this = static_cast<OpenTokSubscriber *>(user_data);
+        _this->logger.debug("{}: recording stream {}", __FUNCTION__, _this->streamId);
+    }
+
+    /**
+     * Runs on the SDK's render thread, so only the plane copy into the recorder's mapped segment happens here.
+     */
+    static void on_subscriber_render_frame(otc_subscriber *subscriber, void *user_data,
+                                           const otc_video_frame *frame) {
+        TRACE_SCOPE("record_frame");
+        auto _this = static_cast<OpenTokSubscriber *>(user_data);
+        if (_this == nullptr || frame == nullptr) {
+            return;
+        }
+
+        otc_video_frame *converted = nullptr;
+        if (otc_video_frame_get_format(frame) != OTC_VIDEO_FRAME_FORMAT_YUV420P) {
+            converted = otc_video_frame_convert(OTC_VIDEO_FRAME_FORMAT_YUV420P, frame);
+            if (converted == nullptr) {
+                _this->logger.error("{}: could not convert frame of stream {}", __FUNCTION__, _this->streamId);
+                return;
+            }
+            frame = converted;
+        }
+
+        constexpr otc_video_frame_plane planeIds[3] = {OTC_VIDEO_FRAME_PLANE_Y, OTC_VIDEO_FRAME_PLANE_U,
+                                                       OTC_VIDEO_FRAME_PLANE_V};
+        PlaneView planes[3];
+        for (int i = 0; i < 3; i++) {
+            planes[i] = PlaneView{otc_video_frame_get_plane_binary_data(frame, planeIds[i]),
+                                  otc_video_frame_get_plane_stride(frame, planeIds[i]),
+                                  otc_video_frame_get_plane_width(frame, planeIds[i]),
+                                  otc_video_frame_get_plane_height(frame, planeIds[i])};
+        }
+        _this->recorder.writeFrame(planes);
+
+        if (converted != nullptr) {
+            otc_video_frame_delete(converted);
+        }
+    }
+
+    static void on_subscriber_error(otc_subscriber *subscriber, void *user_data, const char *error_string,
+                                    enum otc_subscriber_error_code error_code) {
+        TRACE_SCOPE(__FUNCTION__);
+        auto _this = static_cast<OpenTokSubscriber *>(user_data);
+        _this->logger.error("{}: Subscriber error on stream {}: {}", __FUNCTION__, _this->streamId, error_string);
+    }
+
+    Logger logger{"OpenTokSubscriber"};
+
+    const std::string streamId;
+    StreamRecorder recorder;
+    otc_subscriber *subscriber{nullptr};
 };
 
 class OpenTokClient {
 public:
-    OpenTokClient(std::string apiKey, std::string sessionId, std::string token) : apiKey(std::move(apiKey)),
-                                                               sessionId(std::move(sessionId)), token(std::move(token)) {
+    OpenTokClient(std::string apiKey, std::string sessionId, std::string token, VideoSettings videoSettings,
+                  AudioSettings audioSettings, RecordingSettings recordingSettings)
+            : apiKey(std::move(apiKey)), sessionId(std::move(sessionId)), token(std::move(token)),
+              videoSettings(std::move(videoSettings)), audioSettings(std::move(audioSettings)),
+              recordingSettings(std::move(recordingSettings)) {
         if (otc_init(nullptr) != OTC_SUCCESS) {
             throw std::runtime_error("Could not init opentok library");
         }
     }
 
     ~OpenTokClient() {
+        {
+            std::lock_guard lock(subscribersMutex);
+            subscribers.clear();
+        }
         if (session) {
             otc_session_delete(session);
         }
-        if (audioPublisher) {
-            free(audioPublisher);
-        }
-        if (videoPublisher) {
-            free(videoPublisher);
-        }
+        // Publishers have to go before the library is destroyed
+        videoPublishers.clear();
+        simulcastSource.reset();
+        imageSource.reset();
+        cpuGovernor.reset();
         if (otc_destroy() != OTC_SUCCESS) {
             logger.error("Error destroying opentok library");
         }
+        // The audio device callbacks stay registered until the library is destroyed
+        audioPublisher.reset();
+    }
+
+    [[nodiscard]] std::vector<SoakStream> publishedStreams() const {
+        std::vector<SoakStream> streams;
+        for (const auto &videoPublisher: videoPublishers) {
+            streams.push_back(SoakStream{videoPublisher->streamName(), videoPublisher->frameRate()});
+        }
+        return streams;
     }
 
     bool startPublishing() {
@@ -452,13 +1001,15 @@ public:
         if (!session) {
             return false;
         }
-        if (!videoPublisher) {
+        if (videoPublishers.empty()) {
             logger.debug("{}: publisher is null", __FUNCTION__);
             return false;
         }
-        if (!videoPublisher->unPublishFromSession(session)) {
-            logger.debug("{}: error unpublishing from session", __FUNCTION__);
-            return false;
+        for (auto &videoPublisher: videoPublishers) {
+            if (!videoPublisher->unPublishFromSession(session)) {
+                logger.debug("{}: error unpublishing from session", __FUNCTION__);
+                return false;
+            }
         }
         if (isConnected_ && otc_session_disconnect(session) != OTC_SUCCESS) {
             logger.debug("{}: error disconnecting session", __FUNCTION__);
@@ -477,6 +1028,8 @@ private:
         struct otc_session_callbacks sessionCallbacks{
                 .on_connected = &on_session_connected,
                 .on_disconnected = &on_session_disconnected,
+                .on_stream_received = &on_session_stream_received,
+                .on_stream_dropped = &on_session_stream_dropped,
                 .on_error = &on_session_error,
                 .user_data = this
         };
@@ -497,21 +1050,100 @@ private:
     bool initializePublisher() {
         logger.debug(__FUNCTION__);
 
-        audioPublisher = new OpenTokAudioPublisher();
+        if (videoSettings.cpuGovernor.budgetPercent >= 0) {
+            cpuGovernor = std::make_unique<CpuGovernor>(videoSettings.cpuGovernor);
+        }
+
+        audioPublisher = std::make_unique<OpenTokAudioPublisher>(audioSettings);
+        // Audio is shared by every stream, so it is measured but never degraded
+        audioPublisher->setCpuAccount(addCpuAccount("audio", false));
         if (!audioPublisher->initialize()) {
-            logger.error("{}: Could not initialize audio publisher");
+            logger.error("{}: Could not initialize audio publisher", __FUNCTION__);
             return false;
         }
 
-        videoPublisher = new OpenTokVideoPublisher();
-        if (!videoPublisher->initialize()) {
-            logger.error("{}: Could not initialize video publisher");
+        bool playImages = !videoSettings.imageSequence.directory.empty();
+        if (playImages && !videoSettings.layers.empty()) {
+            logger.warn("{}: {} is ignored with {}", __FUNCTION__, VIDEO_LAYERS_ENV, IMAGE_DIR_ENV);
+        }
+        if ((playImages || videoSettings.layers.empty()) && videoSettings.publishers == 1) {
+            videoPublishers.push_back(std::make_unique<OpenTokVideoPublisher>(videoSettings));
+        } else if (playImages || videoSettings.layers.empty()) {
+            for (int i = 0; i < videoSettings.publishers; i++) {
+                auto publisherSettings = videoSettings;
+                publisherSettings.name = fmt::format("{}-{}", videoSettings.name, i);
+                publisherSettings.seed = videoSettings.seed + i;
+                videoPublishers.push_back(std::make_unique<OpenTokVideoPublisher>(publisherSettings));
+            }
+        } else {
+            if (videoSettings.publishers > 1) {
+                logger.warn("{}: {} is ignored with {}", __FUNCTION__, VIDEO_PUBLISHERS_ENV, VIDEO_LAYERS_ENV);
+            }
+            try {
+                simulcastSource = std::make_shared<SimulcastSource>(videoSettings.layers, videoSettings.fps,
+                                                                    videoSettings.renderThreads,
+                                                                    videoSettings.complexity, videoSettings.seed);
+            } catch (const std::invalid_argument &e) {
+                logger.error("{}: {}", __FUNCTION__, e.what());
+                return false;
+            }
+            for (size_t i = 0; i < videoSettings.layers.size(); i++) {
+                auto layerSettings = videoSettings;
+                layerSettings.width = videoSettings.layers[i].width;
+                layerSettings.height = videoSettings.layers[i].height;
+                layerSettings.name = fmt::format("{}-{}x{}", videoSettings.name, layerSettings.width,
+                                                 layerSettings.height);
+                auto videoPublisher = std::make_unique<OpenTokVideoPublisher>(layerSettings);
+                videoPublisher->setSource(simulcastSource, i);
+                videoPublishers.push_back(std::move(videoPublisher));
+            }
+            simulcastSource->setCpuAccount(addCpuAccount("simulcast", false));
+            if (!simulcastSource->start()) {
+                logger.error("{}: Could not start simulcast source", __FUNCTION__);
+                return false;
+            }
+        }
+
+        if (playImages) {
+            // One cache serves every publisher
+            try {
+                imageSource = std::make_shared<ImageSequenceSource>(videoSettings.imageSequence);
+            } catch (const std::invalid_argument &e) {
+                logger.error("{}: {}", __FUNCTION__, e.what());
+                return false;
+            }
+            for (auto &videoPublisher: videoPublishers) {
+                videoPublisher->setImageSource(imageSource);
+            }
+            imageSource->setCpuAccount(addCpuAccount("images", false));
+            if (!imageSource->start()) {
+                logger.error("{}: Could not start image source", __FUNCTION__);
+                return false;
+            }
+        }
+
+        for (auto &videoPublisher: videoPublishers) {
+            // Publishers of a shared source cannot change what it renders
+            videoPublisher->setCpuAccount(addCpuAccount(videoPublisher->streamName(),
+                                                        !simulcastSource && !imageSource));
+            if (!videoPublisher->initialize()) {
+                logger.error("{}: Could not initialize video publisher", __FUNCTION__);
+                return false;
+            }
+        }
+
+        if (cpuGovernor && !cpuGovernor->start()) {
+            logger.error("{}: Could not start CPU governor", __FUNCTION__);
             return false;
         }
 
         return true;
     }
 
+    std::shared_ptr<CpuAccount> addCpuAccount(std::string name, bool governed) {
+        return cpuGovernor ? cpuGovernor->addAccount(std::move(name), governed) : nullptr;
+    }
+
     bool connectSession() {
         if (session == nullptr) {
             logger.error("{}: Could not create opentok session", __FUNCTION__);
@@ -530,6 +1162,7 @@ private:
      */
 
     static void on_session_connected(otc_session *session, void *user_data) {
+        TRACE_SCOPE(__FUNCTION__);
         auto _this = static_cast<OpenTokClient *>(user_data);
         _this->logger.debug(__FUNCTION__);
 
@@ -539,37 +1172,87 @@ private:
             _this->logger.error("{}: session is null", __FUNCTION__);
             return;
         }
-        if (_this->videoPublisher == nullptr) {
+        if (_this->videoPublishers.empty()) {
             _this->logger.error("{}: publisher is null", __FUNCTION__);
             return;
         }
 
-        if (!_this->videoPublisher->publishToSession(session)) {
-            _this->logger.error("{}: could not publish to session", __FUNCTION__);
-            return;
+        for (auto &videoPublisher: _this->videoPublishers) {
+            if (!videoPublisher->publishToSession(session)) {
+                _this->logger.error("{}: could not publish to session", __FUNCTION__);
+                return;
+            }
         }
 
         _this->logger.debug("{}: session successfully connected", __FUNCTION__);
     }
 
     static void on_session_disconnected(otc_session *session, void *user_data) {
+        TRACE_SCOPE(__FUNCTION__);
         auto _this = static_cast<OpenTokClient *>(user_data);
         _this->logger.debug(__FUNCTION__);
         _this->isConnected_ = false;
     }
 
+    static void on_session_stream_received(otc_session *session, void *user_data, const otc_stream *stream) {
+        TRACE_SCOPE(__FUNCTION__);
+        auto _this = static_cast<OpenTokClient *>(user_data);
+        _this->logger.debug(__FUNCTION__);
+
+        if (_this->recordingSettings.directory.empty()) {
+            return;
+        }
+
+        std::string streamId = otc_stream_get_id(stream);
+        auto subscriber = std::make_unique<OpenTokSubscriber>(streamId, _this->recordingSettings);
+        if (!subscriber->initialize(stream) || !subscriber->subscribeToSession(session)) {
+            return;
+        }
+
+        std::lock_guard lock(_this->subscribersMutex);
+        _this->subscribers[streamId] = std::move(subscriber);
+    }
+
+    static void on_session_stream_dropped(otc_session *session, void *user_data, const otc_stream *stream) {
+        TRACE_SCOPE(__FUNCTION__);
+        auto _this = static_cast<OpenTokClient *>(user_data);
+        _this->logger.debug(__FUNCTION__);
+
+        std::unique_ptr<OpenTokSubscriber> subscriber;
+        {
+            std::lock_guard lock(_this->subscribersMutex);
+            auto it = _this->subscribers.find(otc_stream_get_id(stream));
+            if (it == _this->subscribers.end()) {
+                return;
+            }
+            subscriber = std::move(it->second);
+            _this->subscribers.erase(it);
+        }
+        // Closing the recording syncs its last segment, keep that outside the lock
+        subscriber->unSubscribeFromSession(session);
+    }
+
     static void on_session_error(otc_session *session, void *user_data, const char *error_string,
                                  enum otc_session_error_code error) {
+        TRACE_SCOPE(__FUNCTION__);
         auto _this = static_cast<OpenTokClient *>(user_data);
         _this->logger.debug("{}: {}", __FUNCTION__, error_string);
     }
     std::string apiKey;
     std::string sessionId;
     std::string token;
+    VideoSettings videoSettings;
+    AudioSettings audioSettings;
+    RecordingSettings recordingSettings;
 
     otc_session *session{nullptr};
-    OpenTokVideoPublisher *videoPublisher{nullptr};
-    OpenTokAudioPublisher *audioPublisher{nullptr};
+    std::shared_ptr<SimulcastSource> simulcastSource;
+    std::shared_ptr<ImageSequenceSource> imageSource;
+    std::vector<std::unique_ptr<OpenTokVideoPublisher>> videoPublishers;
+    std::unique_ptr<OpenTokAudioPublisher> audioPublisher;
+    std::unique_ptr<CpuGovernor> cpuGovernor;
+    std::mutex subscribersMutex;
+    std::map<std::string, std::unique_ptr<OpenTokSubscriber>> subscribers;
     Logger logger{"OpenTokClient"};
 
     std::atomic<bool> isConnected_{false};
@@ -580,12 +1263,31 @@ int main() {
 
     Logger logger{"Main"};
 
+    auto traceFile = getTraceFile();
+    if (traceFile != nullptr) {
+        Trace::enable(true);
+        Trace::installDumpSignal(SIGUSR1);
+        Trace::setThreadName("main");
+        logger.debug("Tracing enabled, send SIGUSR1 to write {}", traceFile);
+    }
+    auto dumpTrace = [&logger, traceFile]() {
+        if (traceFile == nullptr) {
+            return;
+        }
+        if (Trace::dump(traceFile)) {
+            logger.debug("Trace written to {}", traceFile);
+        } else {
+            logger.error("Could not write trace to {}", traceFile);
+        }
+    };
+
     auto apiKey = getApiKey();
     auto sessionId = getSessionId();
     auto token = getToken();
     logger.debug("Creating OpenTok Client, API Key: {}, Session ID: {}", apiKey, sessionId);
 
-    OpenTokClient client(apiKey, sessionId, token);
+    OpenTokClient client(apiKey, sessionId, token, getVideoSettings(), getAudioSettings(),
+                         getRecordingSettings());
 
     logger.debug("Client created");
 
@@ -596,14 +1298,54 @@ int main() {
         return 1;
     }
 
-    std::this_thread::sleep_for(std::chrono::seconds(30));
+    auto logMetrics = [&logger]() {
+        for (const auto &[name, value]: Metrics::snapshot()) {
+            logger.debug("metric {} = {}", name, value);
+        }
+    };
+
+    auto metricsInterval = std::chrono::seconds(getIntEnv(METRICS_INTERVAL_ENV, 0));
+    auto nextMetricsTime = std::chrono::steady_clock::now() + metricsInterval;
 
-    if (client.stopPublishing()) {
+    // A soak run samples resources every interval and stops as soon as a budget is exceeded
+    auto soakInterval = std::chrono::seconds(getIntEnv(SOAK_INTERVAL_ENV, 0));
+    std::unique_ptr<SoakMonitor> soakMonitor;
+    if (soakInterval.count() > 0) {
+        soakMonitor = std::make_unique<SoakMonitor>(getSoakBudgets(), client.publishedStreams(),
+                                                    std::chrono::seconds(getIntEnv(SOAK_WARMUP_ENV, 60)));
+    }
+    auto nextSoakTime = std::chrono::steady_clock::now() + soakInterval;
+    bool soakPassed = true;
+
+    auto stopTime = std::chrono::steady_clock::now() + std::chrono::seconds(getIntEnv(RUN_SECONDS_ENV, 30));
+    while (soakPassed && std::chrono::steady_clock::now() < stopTime) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (Trace::dumpRequested()) {
+            dumpTrace();
+        }
+        if (metricsInterval.count() > 0 && std::chrono::steady_clock::now() >= nextMetricsTime) {
+            logMetrics();
+            nextMetricsTime += metricsInterval;
+        }
+        if (soakMonitor && std::chrono::steady_clock::now() >= nextSoakTime) {
+            soakPassed = soakMonitor->sample();
+            nextSoakTime += soakInterval;
+        }
+    }
+
+    auto stopped = client.stopPublishing();
+    dumpTrace();
+    logMetrics();
+    if (stopped) {
         logger.debug("Publisher stopped successfully");
     } else {
         logger.error("Could not stop publishing");
         return 1;
     }
+    if (!soakPassed) {
+        logger.error("Soak run failed");
+        return 1;
+    }
 
     return 0;
 }
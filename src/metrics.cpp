@@ -0,0 +1,31 @@
+#include "metrics.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+std::mutex registryMutex;
+std::map<std::string, std::unique_ptr<Metric>> registry;
+
+}
+
+Metric &Metrics::get(const std::string &name) {
+    std::lock_guard lock(registryMutex);
+    auto &metric = registry[name];
+    if (!metric) {
+        metric = std::make_unique<Metric>();
+    }
+    return *metric;
+}
+
+std::vector<std::pair<std::string, int64_t>> Metrics::snapshot() {
+    std::lock_guard lock(registryMutex);
+    std::vector<std::pair<std::string, int64_t>> values;
+    values.reserve(registry.size());
+    for (const auto &[name, metric]: registry) {
+        values.emplace_back(name, metric->value());
+    }
+    return values;
+}
@@ -0,0 +1,48 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * A named counter or gauge. Updates are relaxed atomics and cheap enough for per-frame paths.
+ */
+class Metric {
+public:
+    void add(int64_t amount = 1) {
+        value_.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    void set(int64_t value) {
+        value_.store(value, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] int64_t value() const {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+/**
+ * Process-wide metric registry. Look metrics up once and keep the reference, lookups take a lock.
+ */
+class Metrics {
+public:
+    /**
+     * Returns the metric called name, creating it at zero on first use. The reference stays valid for the lifetime
+     * of the process.
+     */
+    static Metric &get(const std::string &name);
+
+    /**
+     * All metrics sorted by name.
+     */
+    static std::vector<std::pair<std::string, int64_t>> snapshot();
+};
+
+#endif // METRICS_H
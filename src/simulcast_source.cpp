@@ -0,0 +1,164 @@
+#include "simulcast_source.h"
+
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include "downscaler.h"
+#include "trace.h"
+
+std::vector<LayerSize> parseLayerSizes(std::string_view text) {
+    std::vector<LayerSize> layers;
+    while (!text.empty()) {
+        auto end = text.find(',');
+        auto item = std::string(text.substr(0, end));
+        text = end == std::string_view::npos ? std::string_view{} : text.substr(end + 1);
+
+        LayerSize layer{};
+        char separator = 0;
+        char trailing = 0;
+        if (std::sscanf(item.c_str(), "%d%c%d%c", &layer.width, &separator, &layer.height, &trailing) != 3 ||
+            separator != 'x' || layer.width <= 0 || layer.height <= 0) {
+            return {};
+        }
+        layers.push_back(layer);
+    }
+    return layers;
+}
+
+SimulcastSource::SimulcastSource(std::vector<LayerSize> layers, int fps, int renderThreads,
+                                 ContentComplexity complexity, uint64_t seed)
+        : layers_(std::move(layers)), fps(std::max(1, fps)), complexity(complexity), seed(seed),
+          loadProfile(complexity, seed, layers_.empty() ? 1 : layers_[0].width,
+                      layers_.empty() ? 1 : layers_[0].height),
+          poolBytes(Metrics::get("simulcast.pool_bytes")) {
+    if (layers_.empty()) {
+        throw std::invalid_argument("SimulcastSource: no layers");
+    }
+    for (size_t i = 1; i < layers_.size(); i++) {
+        if (layers_[i].width > layers_[i - 1].width || layers_[i].height > layers_[i - 1].height) {
+            throw std::invalid_argument("SimulcastSource: layers must be ordered from largest to smallest");
+        }
+        if (layers_[i].width * 2 < layers_[i - 1].width || layers_[i].height * 2 < layers_[i - 1].height) {
+            throw std::invalid_argument(fmt::format("SimulcastSource: {}x{} is less than half of {}x{}, add the "
+                                                    "layers in between", layers_[i].width, layers_[i].height,
+                                                    layers_[i - 1].width, layers_[i - 1].height));
+        }
+    }
+
+    try {
+        renderer = std::make_unique<StripeRenderer>(layers_[0].width, layers_[0].height, 4, renderThreads);
+    } catch (const std::runtime_error &e) {
+        logger.warn("{}: {}, rendering on the source thread only", __FUNCTION__, e.what());
+        renderer = std::make_unique<StripeRenderer>(layers_[0].width, layers_[0].height, 4, 1);
+    }
+    for (size_t i = 0; i < layers_.size(); i++) {
+        layerRenderMicros.push_back(&Metrics::get(fmt::format("simulcast.layer{}.render_us", i)));
+    }
+    latest.resize(layers_.size());
+}
+
+SimulcastSource::~SimulcastSource() {
+    stop();
+}
+
+bool SimulcastSource::start() {
+    if (running) {
+        return true;
+    }
+    exitRenderThread = false;
+    if (otk_thread_create(&renderThread, &render_thread_start_function, this) != 0) {
+        logger.error("{}: could not create render thread", __FUNCTION__);
+        return false;
+    }
+    running = true;
+    return true;
+}
+
+void SimulcastSource::stop() {
+    if (!running) {
+        return;
+    }
+    exitRenderThread = true;
+    otk_thread_join(renderThread);
+    running = false;
+}
+
+VideoFrame SimulcastSource::latestFrame(size_t layer) const {
+    std::lock_guard lock(latestMutex);
+    return layer < latest.size() ? latest[layer] : VideoFrame{};
+}
+
+otk_thread_func_return_type SimulcastSource::render_thread_start_function(void *arg) {
+    auto _this = static_cast<SimulcastSource *>(arg);
+    if (_this == nullptr) {
+        otk_thread_func_return_value;
+    }
+
+    _this->logger.debug("{}: rendering {} layers of {} content at {} fps", __FUNCTION__, _this->layers_.size(),
+                        toString(_this->complexity), _this->fps);
+    Trace::setThreadName("simulcast-source");
+
+    // Workers detach before the renderer is destroyed, which happens after this thread is joined
+    std::vector<CpuAttachment> cpuAttachments;
+    cpuAttachments.emplace_back(_this->cpuAccount);
+    for (auto worker: _this->renderer->workerThreads()) {
+        cpuAttachments.emplace_back(_this->cpuAccount, worker);
+    }
+
+    auto frameInterval = std::chrono::nanoseconds(std::chrono::seconds(1)) / _this->fps;
+    auto nextFrameTime = std::chrono::steady_clock::now();
+    uint64_t index = 0;
+    while (!_this->exitRenderThread.load()) {
+        _this->renderFrame(index++);
+
+        nextFrameTime += frameInterval;
+        auto now = std::chrono::steady_clock::now();
+        if (nextFrameTime < now) {
+            nextFrameTime = now;
+        }
+        TRACE_SCOPE("sleep");
+        std::this_thread::sleep_until(nextFrameTime);
+    }
+
+    otk_thread_func_return_value;
+}
+
+void SimulcastSource::renderFrame(uint64_t index) {
+    TRACE_SCOPE("simulcast_render");
+    std::vector<VideoFrame> frames(layers_.size());
+
+    for (size_t i = 0; i < layers_.size(); i++) {
+        auto start = std::chrono::steady_clock::now();
+        auto &frame = frames[i];
+        frame.width = layers_[i].width;
+        frame.height = layers_[i].height;
+        frame.index = index;
+        frame.buffer = pool->acquire(static_cast<size_t>(frame.width) * frame.height * 4);
+
+        if (i == 0) {
+            loadProfile.beginFrame();
+            renderer->render(frame.buffer.get(), [this](uint8_t *rows, int firstRow, int rowCount) {
+                loadProfile.renderStripe(rows, firstRow, rowCount);
+            });
+        } else {
+            const auto &above = frames[i - 1];
+            auto dst = frame.buffer.get();
+            renderer->render(dst, frame.width, frame.height, [&above, &frame, dst](uint8_t *, int firstRow,
+                                                                                  int rowCount) {
+                downscaleArgb(above.buffer.get(), above.width, above.height,
+                              dst, frame.width, frame.height, firstRow, rowCount);
+            });
+        }
+
+        layerRenderMicros[i]->set(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count());
+    }
+
+    {
+        std::lock_guard lock(latestMutex);
+        latest.swap(frames);
+    }
+    poolBytes.set(static_cast<int64_t>(pool->allocatedBytes()));
+}
@@ -0,0 +1,96 @@
+#ifndef SIMULCAST_SOURCE_H
+#define SIMULCAST_SOURCE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include "cpu_governor.h"
+#include "frame_pool.h"
+#include "load_profile.h"
+#include "logger.h"
+#include "metrics.h"
+#include "otk_thread.h"
+#include "stripe_renderer.h"
+
+struct LayerSize {
+    int width;
+    int height;
+};
+
+/**
+ * Parses "1280x720,640x360,320x180". Returns an empty list if the text is malformed.
+ */
+std::vector<LayerSize> parseLayerSizes(std::string_view text);
+
+/**
+ * Renders one source at the size of the first layer and derives every further layer by downscaling the layer before
+ * it, so each extra layer costs a fraction of a full render. All layers are split into stripes on one StripeRenderer
+ * pool. Each layer may be at most half the size of the layer before it in either dimension, since the downscaler
+ * does not prefilter larger reductions. Layer buffers come from a shared FramePool.
+ *
+ * Publishers pick up the most recent frame of their layer with latestFrame(), each at its own pace.
+ */
+class SimulcastSource {
+public:
+    SimulcastSource(std::vector<LayerSize> layers, int fps, int renderThreads, ContentComplexity complexity,
+                    uint64_t seed);
+
+    ~SimulcastSource();
+
+    SimulcastSource(const SimulcastSource &) = delete;
+
+    SimulcastSource &operator=(const SimulcastSource &) = delete;
+
+    /**
+     * Accounts the render thread and the stripe workers' CPU time. Must be called before start().
+     */
+    void setCpuAccount(std::shared_ptr<CpuAccount> account) {
+        cpuAccount = std::move(account);
+    }
+
+    bool start();
+
+    void stop();
+
+    [[nodiscard]] const std::vector<LayerSize> &layers() const {
+        return layers_;
+    }
+
+    /**
+     * The newest frame of a layer. Its buffer is empty until the first frame has been rendered.
+     */
+    VideoFrame latestFrame(size_t layer) const;
+
+private:
+    static otk_thread_func_return_type render_thread_start_function(void *arg);
+
+    void renderFrame(uint64_t index);
+
+    std::vector<LayerSize> layers_;
+    int fps;
+    ContentComplexity complexity;
+    uint64_t seed;
+
+    std::shared_ptr<FramePool> pool{FramePool::create()};
+    std::unique_ptr<StripeRenderer> renderer;
+    LoadProfile loadProfile;
+
+    mutable std::mutex latestMutex;
+    std::vector<VideoFrame> latest;
+
+    std::vector<Metric *> layerRenderMicros;
+    Metric &poolBytes;
+
+    std::shared_ptr<CpuAccount> cpuAccount;
+
+    otk_thread_t renderThread{};
+    std::atomic<bool> exitRenderThread{false};
+    bool running{false};
+
+    Logger logger{"SimulcastSource"};
+};
+
+#endif // SIMULCAST_SOURCE_H
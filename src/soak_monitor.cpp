@@ -0,0 +1,171 @@
+#include "soak_monitor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include "alloc_counter.h"
+
+namespace {
+
+/**
+ * Frames a span must be expected to hold before its frame rate is judged. Any span can be off by one frame, which
+ * must stay within half the budget.
+ */
+double minimumCadenceFrames(int maxCadenceErrorPercent) {
+    return 200.0 / std::max(1, maxCadenceErrorPercent);
+}
+
+}
+
+ResourceSample ResourceSample::read() {
+    ResourceSample sample{};
+    sample.time = std::chrono::steady_clock::now();
+
+    if (auto statm = fopen("/proc/self/statm", "r")) {
+        long long sizePages = 0;
+        long long residentPages = 0;
+        if (fscanf(statm, "%lld %lld", &sizePages, &residentPages) == 2) {
+            sample.rssKb = residentPages * (sysconf(_SC_PAGESIZE) / 1024);
+        }
+        fclose(statm);
+    }
+
+    if (auto status = fopen("/proc/self/status", "r")) {
+        char line[256];
+        while (fgets(line, sizeof(line), status) != nullptr) {
+            if (strncmp(line, "Threads:", 8) == 0) {
+                sample.threads = strtoll(line + 8, nullptr, 10);
+                break;
+            }
+        }
+        fclose(status);
+    }
+
+    timespec cpuTime{};
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuTime) == 0) {
+        sample.cpuUs = static_cast<int64_t>(cpuTime.tv_sec) * 1000000 + cpuTime.tv_nsec / 1000;
+    }
+
+    auto counts = allocationCounts();
+    sample.allocations = static_cast<int64_t>(counts.allocations);
+    sample.liveAllocations = counts.live();
+    return sample;
+}
+
+SoakMonitor::SoakMonitor(SoakBudgets budgets, const std::vector<SoakStream> &streams, std::chrono::seconds warmup)
+        : budgets(budgets), warmupEnd(std::chrono::steady_clock::now() + warmup), last(ResourceSample::read()),
+          rssKb(Metrics::get("soak.rss_kb")),
+          threads(Metrics::get("soak.threads")),
+          liveAllocations(Metrics::get("soak.live_allocations")),
+          allocationsPerSecond(Metrics::get("soak.allocations_per_second")),
+          cpuPercent(Metrics::get("soak.cpu_percent")),
+          violations(Metrics::get("soak.violations")) {
+    for (const auto &stream: streams) {
+        auto &framesDelivered = Metrics::get(stream.name + ".frames_delivered");
+        auto &startDelayUs = Metrics::get(stream.name + ".frame_start_delay_us");
+        auto &frameSlots = Metrics::get(stream.name + ".frame_slots");
+        this->streams.push_back(StreamState{stream, framesDelivered, startDelayUs, frameSlots,
+                                            framesDelivered.value(), startDelayUs.value(), frameSlots.value(), 0});
+    }
+}
+
+bool SoakMonitor::sample() {
+    auto now = ResourceSample::read();
+    auto elapsed = std::chrono::duration<double>(now.time - last.time).count();
+    if (elapsed <= 0) {
+        return true;
+    }
+
+    auto cpu = static_cast<double>(now.cpuUs - last.cpuUs) / (elapsed * 1e6) * 100.0;
+    auto allocationRate = static_cast<double>(now.allocations - last.allocations) / elapsed;
+    rssKb.set(now.rssKb);
+    threads.set(now.threads);
+    liveAllocations.set(now.liveAllocations);
+    allocationsPerSecond.set(static_cast<int64_t>(allocationRate));
+    cpuPercent.set(static_cast<int64_t>(cpu));
+
+    if (!baseline && now.time >= warmupEnd) {
+        baseline = now;
+        for (auto &state: streams) {
+            state.baselineFrames = state.framesDelivered.value();
+        }
+        logger.debug("soak: warmup over, baseline rss {} KiB, {} threads, {} live allocations", now.rssKb,
+                     now.threads, now.liveAllocations);
+    }
+
+    auto violationsBefore = violations.value();
+    if (baseline) {
+        logger.debug("soak: rss {} KiB ({:+}), {} threads ({:+}), {} live allocations ({:+}), {:.0f} allocations/s, "
+                     "cpu {:.1f}%", now.rssKb, now.rssKb - baseline->rssKb, now.threads,
+                     now.threads - baseline->threads, now.liveAllocations,
+                     now.liveAllocations - baseline->liveAllocations, allocationRate, cpu);
+
+        if (budgets.maxRssGrowthKb >= 0 && now.rssKb - baseline->rssKb > budgets.maxRssGrowthKb) {
+            reportViolation(fmt::format("rss grew by {} KiB, budget {} KiB", now.rssKb - baseline->rssKb,
+                                        budgets.maxRssGrowthKb));
+        }
+        if (budgets.maxThreadGrowth >= 0 && now.threads - baseline->threads > budgets.maxThreadGrowth) {
+            reportViolation(fmt::format("thread count grew by {}, budget {}", now.threads - baseline->threads,
+                                        budgets.maxThreadGrowth));
+        }
+        if (budgets.maxLiveAllocationGrowth >= 0 &&
+            now.liveAllocations - baseline->liveAllocations > budgets.maxLiveAllocationGrowth) {
+            reportViolation(fmt::format("live allocations grew by {}, budget {}",
+                                        now.liveAllocations - baseline->liveAllocations,
+                                        budgets.maxLiveAllocationGrowth));
+        }
+        if (budgets.maxCpuPercent >= 0 && cpu > budgets.maxCpuPercent) {
+            reportViolation(fmt::format("cpu at {:.1f}%, budget {}%", cpu, budgets.maxCpuPercent));
+        }
+    } else {
+        logger.debug("soak: warming up, rss {} KiB, {} threads, {} live allocations, cpu {:.1f}%", now.rssKb,
+                     now.threads, now.liveAllocations, cpu);
+    }
+
+    for (auto &state: streams) {
+        auto frames = state.framesDelivered.value() - state.lastFrames;
+        auto delayUs = state.startDelayUs.value() - state.lastDelayUs;
+        auto slots = state.frameSlots.value() - state.lastSlots;
+        state.lastFrames += frames;
+        state.lastDelayUs += delayUs;
+        state.lastSlots += slots;
+
+        // Dropped slots are late too, so the delay is averaged over every slot rather than the delivered frames
+        auto fps = static_cast<double>(frames) / elapsed;
+        auto meanDelayMs = slots > 0 ? static_cast<double>(delayUs) / static_cast<double>(slots) / 1000.0 : 0.0;
+        logger.debug("soak: {} at {:.2f} fps, frames start {:.2f} ms late on average", state.stream.name, fps,
+                     meanDelayMs);
+
+        if (!baseline) {
+            continue;
+        }
+        // A single interval can be off by one frame, so the cadence is judged over the span since the baseline
+        // once it holds enough frames for that not to matter
+        auto span = std::chrono::duration<double>(now.time - baseline->time).count();
+        if (budgets.maxCadenceErrorPercent >= 0 &&
+            span * state.stream.fps >= minimumCadenceFrames(budgets.maxCadenceErrorPercent)) {
+            auto spanFps = static_cast<double>(state.lastFrames - state.baselineFrames) / span;
+            auto cadenceError = std::abs(spanFps - state.stream.fps) / state.stream.fps * 100.0;
+            if (cadenceError > budgets.maxCadenceErrorPercent) {
+                reportViolation(fmt::format("{} delivered {:.2f} fps since the baseline instead of {}, budget {}%",
+                                            state.stream.name, spanFps, state.stream.fps,
+                                            budgets.maxCadenceErrorPercent));
+            }
+        }
+        if (budgets.maxStartDelayMs >= 0 && meanDelayMs > budgets.maxStartDelayMs) {
+            reportViolation(fmt::format("{} frames started {:.2f} ms late on average, budget {} ms",
+                                        state.stream.name, meanDelayMs, budgets.maxStartDelayMs));
+        }
+    }
+
+    last = now;
+    return violations.value() == violationsBefore;
+}
+
+void SoakMonitor::reportViolation(const std::string &violation) {
+    violations.add();
+    logger.error("soak: budget exceeded, {}", violation);
+}
@@ -0,0 +1,96 @@
+#ifndef SOAK_MONITOR_H
+#define SOAK_MONITOR_H
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "logger.h"
+#include "metrics.h"
+
+/**
+ * Limits for a soak run. Growth is measured against the baseline taken when the warmup ends. A negative limit
+ * disables the check.
+ */
+struct SoakBudgets {
+    int64_t maxRssGrowthKb = 64 * 1024;
+    int64_t maxThreadGrowth = 0;
+    int64_t maxLiveAllocationGrowth = 100000;
+    // How far a stream's delivered frame rate may be off its configured rate over one interval
+    int maxCadenceErrorPercent = 10;
+    // Mean delay between a frame's scheduled and actual start over one interval
+    int maxStartDelayMs = 5;
+    // Process CPU time over one interval, 100 is one core
+    int maxCpuPercent = -1;
+};
+
+/**
+ * A published stream, identified by the metric prefix its capture loop reports under.
+ */
+struct SoakStream {
+    std::string name;
+    int fps;
+};
+
+struct ResourceSample {
+    std::chrono::steady_clock::time_point time;
+    int64_t rssKb;
+    int64_t threads;
+    int64_t liveAllocations;
+    int64_t allocations;
+    int64_t cpuUs;
+
+    /**
+     * Reads the process's resident set from /proc/self/statm, its thread count from /proc/self/status, its CPU time
+     * and the allocation counters.
+     */
+    static ResourceSample read();
+};
+
+/**
+ * Qualifies a long run. Each sample() logs the process's resources and every stream's frame cadence, exports them as
+ * soak.* metrics and checks them against the budgets. Once the warmup is over the first sample becomes the baseline
+ * that growth is measured against, so steady-state caches and pools do not count as leaks.
+ */
+class SoakMonitor {
+public:
+    SoakMonitor(SoakBudgets budgets, const std::vector<SoakStream> &streams, std::chrono::seconds warmup);
+
+    /**
+     * Takes a sample. Returns false if it exceeded a budget, with the violation logged.
+     */
+    bool sample();
+
+private:
+    struct StreamState {
+        SoakStream stream;
+        Metric &framesDelivered;
+        Metric &startDelayUs;
+        Metric &frameSlots;
+        int64_t lastFrames;
+        int64_t lastDelayUs;
+        int64_t lastSlots;
+        // Frames delivered when the baseline was taken, cadence is judged over the whole span since
+        int64_t baselineFrames;
+    };
+
+    void reportViolation(const std::string &violation);
+
+    SoakBudgets budgets;
+    std::vector<StreamState> streams;
+    std::chrono::steady_clock::time_point warmupEnd;
+    ResourceSample last;
+    std::optional<ResourceSample> baseline;
+
+    Metric &rssKb;
+    Metric &threads;
+    Metric &liveAllocations;
+    Metric &allocationsPerSecond;
+    Metric &cpuPercent;
+    Metric &violations;
+
+    Logger logger{"SoakMonitor"};
+};
+
+#endif // SOAK_MONITOR_H
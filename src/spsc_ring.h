@@ -0,0 +1,64 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * Lock-free ring for exactly one producer and one consumer thread. Slots are filled and read in place, so large
+ * elements such as audio blocks are never copied through the ring.
+ */
+template<typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    /**
+     * Producer: the slot to fill next, or nullptr when the ring is full. Publish it with commitPush().
+     */
+    T *beginPush() {
+        auto head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) == Capacity) {
+            return nullptr;
+        }
+        return &slots[head & (Capacity - 1)];
+    }
+
+    void commitPush() {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /**
+     * Consumer: the oldest slot, or nullptr when the ring is empty. Release it with pop().
+     */
+    const T *front() const {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if (head_.load(std::memory_order_acquire) == tail) {
+            return nullptr;
+        }
+        return &slots[tail & (Capacity - 1)];
+    }
+
+    void pop() {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /**
+     * Approximate when called from a third thread.
+     */
+    [[nodiscard]] size_t size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity() {
+        return Capacity;
+    }
+
+private:
+    // Separate cache lines so the producer and the consumer do not invalidate each other's index
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) T slots[Capacity];
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,293 @@
+#include "stream_recorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+#include "trace.h"
+
+namespace {
+
+constexpr auto flushInterval = std::chrono::milliseconds(100);
+constexpr auto maxSegmentRetryDelay = std::chrono::seconds(5);
+// Room left for the Y4M stream header at the start of each segment
+constexpr size_t maxHeaderBytes = 64;
+// What a segment grows to hold once a frame does not fit, at least a second of frames so that the flusher has time
+// to prepare the next one
+constexpr size_t minFramesPerSegment = 4;
+constexpr size_t segmentGranularity = 1024 * 1024;
+constexpr char frameMarker[] = "FRAME\n";
+constexpr size_t frameMarkerBytes = sizeof(frameMarker) - 1;
+
+size_t pageAlignDown(size_t offset) {
+    static const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return offset - offset % pageSize;
+}
+
+}
+
+std::optional<RecordingFormat> parseRecordingFormat(std::string_view name) {
+    if (name == "y4m") {
+        return RecordingFormat::Y4m;
+    }
+    if (name == "raw") {
+        return RecordingFormat::Raw;
+    }
+    return std::nullopt;
+}
+
+StreamRecorder::StreamRecorder(std::string directory, std::string name, RecordingFormat format,
+                               size_t segmentBytes, int fps)
+        : directory(std::move(directory)), name(std::move(name)), format(format), segmentBytes(segmentBytes),
+          fps(std::max(1, fps)),
+          framesWritten(Metrics::get("recorder." + this->name + ".frames_written")),
+          framesDropped(Metrics::get("recorder." + this->name + ".frames_dropped")),
+          bytesWritten(Metrics::get("recorder." + this->name + ".bytes_written")),
+          segments(Metrics::get("recorder." + this->name + ".segments")),
+          writeKiBps(Metrics::get("recorder." + this->name + ".write_kib_per_second")) {
+    // The recorder is created on an SDK callback thread, so even the first segment is prepared by the flusher
+    if (otk_thread_create(&flusherThread, &flusher_thread_start_function, this) != 0) {
+        logger.error("{}: could not create flusher thread", __FUNCTION__);
+    } else {
+        flusherRunning = true;
+    }
+}
+
+StreamRecorder::~StreamRecorder() {
+    if (flusherRunning) {
+        exitFlusherThread = true;
+        otk_thread_join(flusherThread);
+    }
+
+    for (auto &segment: retired) {
+        closeSegment(segment, true);
+    }
+    if (current.data != nullptr) {
+        closeSegment(current, true);
+    }
+    if (next) {
+        closeSegment(*next, false);
+    }
+}
+
+bool StreamRecorder::writeFrame(const PlaneView (&planes)[3]) {
+    auto width = planes[0].width;
+    auto height = planes[0].height;
+
+    size_t frameBytes = format == RecordingFormat::Y4m ? frameMarkerBytes : 0;
+    for (const auto &plane: planes) {
+        frameBytes += static_cast<size_t>(plane.width) * plane.height;
+    }
+
+    auto headerBytes = format == RecordingFormat::Y4m ? maxHeaderBytes : 0;
+    if (headerBytes + frameBytes > segmentBytes.load(std::memory_order_relaxed)) {
+        growSegments(frameBytes);
+        framesDropped.add();
+        return false;
+    }
+
+    if (current.data == nullptr || width != currentWidth || height != currentHeight ||
+        current.used + frameBytes > current.capacity) {
+        if (!startSegment(width, height, headerBytes + frameBytes) || current.used + frameBytes > current.capacity) {
+            framesDropped.add();
+            return false;
+        }
+    }
+
+    auto out = current.data + current.used;
+    if (format == RecordingFormat::Y4m) {
+        memcpy(out, frameMarker, frameMarkerBytes);
+        out += frameMarkerBytes;
+    }
+    for (const auto &plane: planes) {
+        for (int row = 0; row < plane.height; row++) {
+            memcpy(out, plane.data + static_cast<size_t>(row) * plane.stride, plane.width);
+            out += plane.width;
+        }
+    }
+
+    current.used += frameBytes;
+    currentUsed.store(current.used, std::memory_order_release);
+    framesWritten.add();
+    bytesWritten.add(static_cast<int64_t>(frameBytes));
+    return true;
+}
+
+void StreamRecorder::growSegments(size_t frameBytes) {
+    auto grown = maxHeaderBytes + frameBytes * std::max(minFramesPerSegment, static_cast<size_t>(fps));
+    grown = (grown + segmentGranularity - 1) / segmentGranularity * segmentGranularity;
+    logger.warn("{}: {} byte frames do not fit {} byte segments, recording into {} byte segments", __FUNCTION__,
+                frameBytes, segmentBytes.load(std::memory_order_relaxed), grown);
+    segmentBytes.store(grown, std::memory_order_relaxed);
+}
+
+bool StreamRecorder::startSegment(int width, int height, size_t frameBytes) {
+    {
+        std::lock_guard lock(segmentMutex);
+        // A segment prepared before the segments grew is replaced by the flusher
+        if (!next || next->capacity < frameBytes) {
+            return false;
+        }
+        if (current.data != nullptr) {
+            retired.push_back(current);
+        }
+        current = *next;
+        next.reset();
+        flushData = current.data;
+        flushedBytes = 0;
+        currentUsed.store(0, std::memory_order_relaxed);
+    }
+
+    currentWidth = width;
+    currentHeight = height;
+    if (format == RecordingFormat::Y4m) {
+        auto header = snprintf(reinterpret_cast<char *>(current.data), current.capacity,
+                               "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+        current.used = header > 0 ? static_cast<size_t>(header) : 0;
+        currentUsed.store(current.used, std::memory_order_release);
+    }
+    segments.add();
+    return true;
+}
+
+std::optional<StreamRecorder::Segment> StreamRecorder::openSegment() {
+    Segment segment;
+    segment.path = fmt::format("{}/{}-{}.{}", directory, name, segmentIndex++,
+                               format == RecordingFormat::Y4m ? "y4m" : "yuv");
+    segment.fd = open(segment.path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (segment.fd < 0) {
+        return std::nullopt;
+    }
+
+    // Reserve the blocks up front so appending never has to wait for the filesystem to allocate
+    auto capacity = segmentBytes.load(std::memory_order_relaxed);
+    if (posix_fallocate(segment.fd, 0, static_cast<off_t>(capacity)) != 0 &&
+        ftruncate(segment.fd, static_cast<off_t>(capacity)) != 0) {
+        close(segment.fd);
+        unlink(segment.path.c_str());
+        return std::nullopt;
+    }
+
+    auto mapped = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, segment.fd, 0);
+    if (mapped == MAP_FAILED) {
+        close(segment.fd);
+        unlink(segment.path.c_str());
+        return std::nullopt;
+    }
+    madvise(mapped, capacity, MADV_SEQUENTIAL);
+
+    segment.data = static_cast<uint8_t *>(mapped);
+    segment.capacity = capacity;
+    return segment;
+}
+
+void StreamRecorder::closeSegment(Segment &segment, bool keep) {
+    if (keep) {
+        msync(segment.data, segment.used, MS_SYNC);
+    }
+    munmap(segment.data, segment.capacity);
+    if (keep) {
+        // Give back the preallocated tail
+        if (ftruncate(segment.fd, static_cast<off_t>(segment.used)) != 0) {
+            logger.error("{}: could not truncate {}", __FUNCTION__, segment.path);
+        }
+    } else {
+        unlink(segment.path.c_str());
+    }
+    close(segment.fd);
+    segment = Segment{};
+}
+
+void StreamRecorder::flush() {
+    TRACE_SCOPE("recorder_flush");
+
+    std::vector<Segment> full;
+    std::optional<Segment> outgrown;
+    bool needNext;
+    uint8_t *data;
+    size_t used;
+    size_t flushed;
+    {
+        std::lock_guard lock(segmentMutex);
+        full.swap(retired);
+        if (next && next->capacity < segmentBytes.load(std::memory_order_relaxed)) {
+            outgrown = std::move(next);
+            next.reset();
+        }
+        needNext = !next;
+        data = flushData;
+        used = currentUsed.load(std::memory_order_acquire);
+        flushed = flushedBytes;
+        flushedBytes = used;
+    }
+
+    // Start write-back of what was appended since the last pass, the segment stays mapped until it is retired
+    if (data != nullptr && used > flushed) {
+        auto start = pageAlignDown(flushed);
+        msync(data + start, used - start, MS_ASYNC);
+    }
+
+    for (auto &segment: full) {
+        closeSegment(segment, true);
+    }
+    if (outgrown) {
+        closeSegment(*outgrown, false);
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (needNext && now >= nextSegmentAttempt) {
+        auto segment = openSegment();
+        if (segment) {
+            if (segmentsFailing) {
+                logger.debug("{}: creating segments in {} again", __FUNCTION__, directory);
+            }
+            segmentsFailing = false;
+            segmentRetryDelay = std::chrono::milliseconds(0);
+            std::lock_guard lock(segmentMutex);
+            next = std::move(segment);
+        } else {
+            if (!segmentsFailing) {
+                logger.error("{}: could not create a segment in {}, retrying in the background", __FUNCTION__,
+                             directory);
+            }
+            segmentsFailing = true;
+            segmentRetryDelay = std::min<std::chrono::milliseconds>(
+                    std::max<std::chrono::milliseconds>(segmentRetryDelay * 2, flushInterval), maxSegmentRetryDelay);
+            nextSegmentAttempt = now + segmentRetryDelay;
+        }
+    }
+}
+
+otk_thread_func_return_type StreamRecorder::flusher_thread_start_function(void *arg) {
+    auto _this = static_cast<StreamRecorder *>(arg);
+    if (_this == nullptr) {
+        otk_thread_func_return_value;
+    }
+
+    Trace::setThreadName("recorder-flusher");
+
+    // Prepares the first segment, frames arriving before it is ready are dropped
+    _this->flush();
+
+    auto lastBytes = _this->bytesWritten.value();
+    auto lastTime = std::chrono::steady_clock::now();
+    while (!_this->exitFlusherThread.load()) {
+        std::this_thread::sleep_for(flushInterval);
+        _this->flush();
+
+        auto now = std::chrono::steady_clock::now();
+        auto bytes = _this->bytesWritten.value();
+        auto elapsed = std::chrono::duration<double>(now - lastTime).count();
+        if (elapsed >= 1.0) {
+            _this->writeKiBps.set(static_cast<int64_t>((bytes - lastBytes) / 1024.0 / elapsed));
+            lastBytes = bytes;
+            lastTime = now;
+        }
+    }
+
+    otk_thread_func_return_value;
+}
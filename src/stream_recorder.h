@@ -0,0 +1,120 @@
+#ifndef STREAM_RECORDER_H
+#define STREAM_RECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "logger.h"
+#include "metrics.h"
+#include "otk_thread.h"
+
+enum class RecordingFormat {
+    // YUV4MPEG2, plays in ffplay/mpv and converts with ffmpeg
+    Y4m,
+    // Bare I420 planes back to back
+    Raw
+};
+
+std::optional<RecordingFormat> parseRecordingFormat(std::string_view name);
+
+/**
+ * One plane of an I420 frame.
+ */
+struct PlaneView {
+    const uint8_t *data;
+    int stride;
+    int width;
+    int height;
+};
+
+/**
+ * Records received I420 frames into a sequence of memory-mapped segment files, <directory>/<name>-<n>.y4m.
+ *
+ * writeFrame() runs on the SDK's render thread and only copies the planes into the mapped segment, so it never
+ * allocates, never blocks on I/O and never waits for the flusher. A background flusher thread writes dirty pages
+ * back, preallocates and maps every segment ahead of time, the first one included, and closes full segments. A frame
+ * that does not fit the current segment moves to the prepared next one; if that is not ready yet, as before the
+ * first segment exists, the frame is dropped and counted. A new segment is also started when the frame size changes,
+ * since a Y4M stream has a fixed size. A frame too large for an empty segment is dropped and segments grow to hold a
+ * second of such frames from then on, rather than starting a segment per frame.
+ */
+class StreamRecorder {
+public:
+    StreamRecorder(std::string directory, std::string name, RecordingFormat format, size_t segmentBytes, int fps);
+
+    ~StreamRecorder();
+
+    StreamRecorder(const StreamRecorder &) = delete;
+
+    StreamRecorder &operator=(const StreamRecorder &) = delete;
+
+    bool writeFrame(const PlaneView (&planes)[3]);
+
+private:
+    struct Segment {
+        int fd{-1};
+        uint8_t *data{nullptr};
+        size_t capacity{0};
+        size_t used{0};
+        std::string path;
+    };
+
+    static otk_thread_func_return_type flusher_thread_start_function(void *arg);
+
+    std::optional<Segment> openSegment();
+
+    void closeSegment(Segment &segment, bool keep);
+
+    bool startSegment(int width, int height, size_t frameBytes);
+
+    void growSegments(size_t frameBytes);
+
+    void flush();
+
+    std::string directory;
+    std::string name;
+    RecordingFormat format;
+    // Only grows, prepared segments smaller than this are replaced by the flusher
+    std::atomic<size_t> segmentBytes;
+    int fps;
+
+    // Owned by the writing thread
+    Segment current;
+    int currentWidth{0};
+    int currentHeight{0};
+
+    // Handed between the writer and the flusher under segmentMutex, which the writer only takes when rotating and
+    // the flusher takes briefly on every pass
+    std::mutex segmentMutex;
+    std::optional<Segment> next;
+    std::vector<Segment> retired;
+    uint8_t *flushData{nullptr};
+    size_t flushedBytes{0};
+    std::atomic<size_t> currentUsed{0};
+    int segmentIndex{0};
+
+    // Owned by the flusher, failing to create segments is logged once and retried with a growing delay
+    bool segmentsFailing{false};
+    std::chrono::milliseconds segmentRetryDelay{0};
+    std::chrono::steady_clock::time_point nextSegmentAttempt{};
+
+    otk_thread_t flusherThread{};
+    std::atomic<bool> exitFlusherThread{false};
+    bool flusherRunning{false};
+
+    Metric &framesWritten;
+    Metric &framesDropped;
+    Metric &bytesWritten;
+    Metric &segments;
+    Metric &writeKiBps;
+
+    Logger logger{"StreamRecorder"};
+};
+
+#endif // STREAM_RECORDER_H
@@ -0,0 +1,156 @@
+#include "stripe_renderer.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include "trace.h"
+
+namespace {
+
+// Half of a typical per-core L2, so a stripe and the code touching it stay resident while it is written.
+constexpr size_t targetStripeBytes = 128 * 1024;
+
+// Enough stripes per thread that dynamic hand-out can even out uneven stripes and noisy cores.
+constexpr int minStripesPerThread = 4;
+
+}
+
+StripeRenderer::StripeRenderer(int width, int height, int bytesPerPixel, int threadCount)
+        : bytesPerPixel(bytesPerPixel) {
+    if (width <= 0 || height <= 0 || bytesPerPixel <= 0) {
+        throw std::invalid_argument("StripeRenderer: invalid frame dimensions");
+    }
+    threadCount = std::clamp(threadCount, 1, height);
+    layout = layoutFor(width, height, bytesPerPixel, threadCount);
+
+    workers.reserve(threadCount - 1);
+    for (int i = 1; i < threadCount; i++) {
+        otk_thread_t worker;
+        if (otk_thread_create(&worker, &worker_thread_start_function, this) != 0) {
+            // The destructor does not run for a throwing constructor, the workers must not outlive this
+            stopWorkers();
+            throw std::runtime_error("StripeRenderer: could not create worker thread");
+        }
+        workers.push_back(worker);
+    }
+}
+
+StripeRenderer::~StripeRenderer() {
+    stopWorkers();
+}
+
+void StripeRenderer::stopWorkers() {
+    {
+        std::lock_guard lock(mutex);
+        exitWorkers = true;
+    }
+    frameReady.notify_all();
+    for (auto worker: workers) {
+        otk_thread_join(worker);
+    }
+}
+
+StripeRenderer::StripeLayout StripeRenderer::layoutFor(int width, int height, int bytesPerPixel, int threadCount) {
+    StripeLayout frameLayout{};
+    frameLayout.height = height;
+    frameLayout.rowBytes = static_cast<size_t>(width) * bytesPerPixel;
+
+    // Stripes are kept to an even number of rows so that 2x2 subsampled planes never straddle two stripes.
+    auto rows = static_cast<int>(std::max<size_t>(1, targetStripeBytes / frameLayout.rowBytes));
+    rows = std::min(rows, std::max(1, height / (threadCount * minStripesPerThread)));
+    frameLayout.stripeRows = std::min(height, (rows + 1) & ~1);
+    frameLayout.stripeCount = (height + frameLayout.stripeRows - 1) / frameLayout.stripeRows;
+    return frameLayout;
+}
+
+int StripeRenderer::defaultThreadCount() {
+    return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+void StripeRenderer::render(uint8_t *frameBuffer, const StripeFunction &stripeFunction) {
+    render(frameBuffer, layout, stripeFunction);
+}
+
+void StripeRenderer::render(uint8_t *frameBuffer, int width, int height, const StripeFunction &stripeFunction) {
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    render(frameBuffer, layoutFor(width, height, bytesPerPixel, threadCount()), stripeFunction);
+}
+
+void StripeRenderer::render(uint8_t *frameBuffer, const StripeLayout &frameLayout,
+                            const StripeFunction &stripeFunction) {
+    if (workers.empty()) {
+        stripeFunction(frameBuffer, 0, frameLayout.height);
+        return;
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        current = frameLayout;
+        buffer = frameBuffer;
+        function = &stripeFunction;
+        nextStripe.store(0, std::memory_order_relaxed);
+        busyWorkers = static_cast<int>(workers.size());
+        generation++;
+    }
+    frameReady.notify_all();
+
+    renderStripes();
+
+    std::unique_lock lock(mutex);
+    frameDone.wait(lock, [this] { return busyWorkers == 0; });
+    buffer = nullptr;
+    function = nullptr;
+}
+
+void StripeRenderer::renderStripes() {
+    for (;;) {
+        auto stripe = nextStripe.fetch_add(1, std::memory_order_relaxed);
+        if (stripe >= current.stripeCount) {
+            return;
+        }
+        auto firstRow = stripe * current.stripeRows;
+        auto rowCount = std::min(current.stripeRows, current.height - firstRow);
+        (*function)(buffer + firstRow * current.rowBytes, firstRow, rowCount);
+    }
+}
+
+otk_thread_func_return_type StripeRenderer::worker_thread_start_function(void *arg) {
+    auto _this = static_cast<StripeRenderer *>(arg);
+    if (_this == nullptr) {
+        otk_thread_func_return_value;
+    }
+
+    Trace::setThreadName("stripe-renderer");
+
+    uint64_t renderedGeneration = 0;
+    for (;;) {
+        {
+            std::unique_lock lock(_this->mutex);
+            _this->frameReady.wait(lock, [&] {
+                return _this->exitWorkers || _this->generation != renderedGeneration;
+            });
+            if (_this->exitWorkers) {
+                break;
+            }
+            renderedGeneration = _this->generation;
+        }
+
+        {
+            TRACE_SCOPE("render_stripes");
+            _this->renderStripes();
+        }
+
+        bool lastWorker;
+        {
+            std::lock_guard lock(_this->mutex);
+            lastWorker = --_this->busyWorkers == 0;
+        }
+        if (lastWorker) {
+            _this->frameDone.notify_one();
+        }
+    }
+
+    otk_thread_func_return_value;
+}
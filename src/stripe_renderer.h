@@ -0,0 +1,107 @@
+#ifndef STRIPE_RENDERER_H
+#define STRIPE_RENDERER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "otk_thread.h"
+
+/**
+ * Renders frames in horizontal stripes on a persistent pool of worker threads.
+ *
+ * The thread calling render() works on stripes as well, so a renderer with N threads owns N - 1 workers. Each call
+ * to render() is a barrier: it returns once every stripe of the frame has been written. Stripes are handed out
+ * dynamically so a slow core does not hold the whole frame back.
+ *
+ * The pool is sized for the frame it was created with, but can also render frames of any other size with the same
+ * bytes per pixel, so several layers can share one set of workers.
+ */
+class StripeRenderer {
+public:
+    /**
+     * Renders rowCount rows starting at firstRow. rows points at the first byte of firstRow.
+     */
+    using StripeFunction = std::function<void(uint8_t *rows, int firstRow, int rowCount)>;
+
+    /**
+     * Throws std::invalid_argument for an empty frame and std::runtime_error if a worker cannot be created, after
+     * stopping the workers created so far. A renderer with one thread creates no workers and cannot fail that way.
+     */
+    StripeRenderer(int width, int height, int bytesPerPixel, int threadCount);
+
+    ~StripeRenderer();
+
+    StripeRenderer(const StripeRenderer &) = delete;
+
+    StripeRenderer &operator=(const StripeRenderer &) = delete;
+
+    void render(uint8_t *buffer, const StripeFunction &function);
+
+    /**
+     * Renders a width x height frame instead of the size the renderer was created with.
+     */
+    void render(uint8_t *buffer, int width, int height, const StripeFunction &function);
+
+    [[nodiscard]] int threadCount() const {
+        return static_cast<int>(workers.size()) + 1;
+    }
+
+    [[nodiscard]] int stripeCount() const {
+        return layout.stripeCount;
+    }
+
+    [[nodiscard]] int stripeRows() const {
+        return layout.stripeRows;
+    }
+
+    /**
+     * The pool's worker threads, valid until the renderer is destroyed.
+     */
+    [[nodiscard]] const std::vector<otk_thread_t> &workerThreads() const {
+        return workers;
+    }
+
+    static int defaultThreadCount();
+
+private:
+    struct StripeLayout {
+        int height;
+        size_t rowBytes;
+        int stripeRows;
+        int stripeCount;
+    };
+
+    static StripeLayout layoutFor(int width, int height, int bytesPerPixel, int threadCount);
+
+    static otk_thread_func_return_type worker_thread_start_function(void *arg);
+
+    void stopWorkers();
+
+    void render(uint8_t *buffer, const StripeLayout &frameLayout, const StripeFunction &function);
+
+    void renderStripes();
+
+    int bytesPerPixel;
+    StripeLayout layout;
+    // Layout of the frame being rendered, set under the mutex before workers are woken
+    StripeLayout current{};
+
+    std::vector<otk_thread_t> workers;
+
+    std::mutex mutex;
+    std::condition_variable frameReady;
+    std::condition_variable frameDone;
+    uint64_t generation{0};
+    int busyWorkers{0};
+    bool exitWorkers{false};
+
+    uint8_t *buffer{nullptr};
+    const StripeFunction *function{nullptr};
+    std::atomic<int> nextStripe{0};
+};
+
+#endif // STRIPE_RENDERER_H
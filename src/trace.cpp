@@ -0,0 +1,208 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <csignal>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+#include "fmt/format.h"
+
+std::atomic<bool> Trace::enabled_{false};
+std::atomic<bool> Trace::dumpRequested_{false};
+
+namespace {
+
+constexpr size_t eventsPerThread = 16 * 1024;
+// Rings of exited threads kept for the next dump, beyond this the oldest are dropped
+constexpr size_t maxExitedRings = 64;
+// Released rings kept for reuse by new threads
+constexpr size_t maxFreeRings = 8;
+
+struct TraceEvent {
+    std::atomic<const char *> name{nullptr};
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> end{0};
+};
+
+/**
+ * Single-writer ring owned by one thread. The dumping thread reads it concurrently and drops any slot the writer
+ * may have lapped while it was being copied.
+ */
+struct ThreadRing {
+    uint32_t tid{0};
+    std::string name;
+    std::atomic<uint64_t> head{0};
+    bool exited{false};
+    TraceEvent events[eventsPerThread];
+};
+
+std::mutex registryMutex;
+std::vector<std::shared_ptr<ThreadRing>> registry;
+std::vector<std::shared_ptr<ThreadRing>> freeRings;
+uint32_t nextTid{1};
+
+/**
+ * Takes a ring out of the registry, keeping it for reuse unless a dump still holds it. Needs registryMutex.
+ */
+void releaseRing(std::vector<std::shared_ptr<ThreadRing>>::iterator ring) {
+    if (ring->use_count() == 1 && freeRings.size() < maxFreeRings) {
+        freeRings.push_back(std::move(*ring));
+    }
+    registry.erase(ring);
+}
+
+/**
+ * Owns the calling thread's ring. A ring stays registered after its thread exits so that its events still make it
+ * into the next dump, which then releases it. Threads that come and go between dumps, such as stripe workers being
+ * rebuilt at another resolution, only keep the newest maxExitedRings.
+ */
+struct ThreadRingOwner {
+    std::shared_ptr<ThreadRing> ring;
+
+    ~ThreadRingOwner() {
+        if (!ring) {
+            return;
+        }
+        std::lock_guard lock(registryMutex);
+        ring->exited = true;
+        auto exitedCount = std::count_if(registry.begin(), registry.end(), [](const auto &registered) {
+            return registered->exited;
+        });
+        if (static_cast<size_t>(exitedCount) > maxExitedRings) {
+            releaseRing(std::find_if(registry.begin(), registry.end(), [](const auto &registered) {
+                return registered->exited;
+            }));
+        }
+    }
+};
+
+thread_local ThreadRingOwner threadRing;
+
+// Rings are only allocated once a thread records, so naming a thread costs nothing while tracing is disabled
+thread_local const char *threadName = nullptr;
+
+ThreadRing &currentRing() {
+    if (!threadRing.ring) {
+        std::shared_ptr<ThreadRing> ring;
+        std::lock_guard lock(registryMutex);
+        if (!freeRings.empty()) {
+            ring = std::move(freeRings.back());
+            freeRings.pop_back();
+            ring->head.store(0, std::memory_order_relaxed);
+            ring->exited = false;
+            ring->name.clear();
+        } else {
+            ring = std::make_shared<ThreadRing>();
+        }
+        ring->tid = nextTid++;
+        if (threadName != nullptr) {
+            ring->name = threadName;
+        }
+        registry.push_back(ring);
+        threadRing.ring = std::move(ring);
+    }
+    return *threadRing.ring;
+}
+
+std::string escape(const char *text) {
+    std::string escaped;
+    for (; *text != '\0'; text++) {
+        if (*text == '"' || *text == '\\') {
+            escaped += '\\';
+        }
+        escaped += *text;
+    }
+    return escaped;
+}
+
+}
+
+void Trace::setThreadName(const char *name) {
+    threadName = name;
+    if (threadRing.ring) {
+        std::lock_guard lock(registryMutex);
+        threadRing.ring->name = name;
+    }
+}
+
+void Trace::installDumpSignal(int signal) {
+    std::signal(signal, &onDumpSignal);
+}
+
+void Trace::onDumpSignal(int) {
+    dumpRequested_.store(true, std::memory_order_relaxed);
+}
+
+void Trace::record(const char *name, uint64_t start, uint64_t end) {
+    auto &ring = currentRing();
+    auto head = ring.head.load(std::memory_order_relaxed);
+    auto &event = ring.events[head % eventsPerThread];
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+bool Trace::dump(const std::string &path) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+
+    std::vector<std::shared_ptr<ThreadRing>> rings;
+    {
+        std::lock_guard lock(registryMutex);
+        rings = registry;
+    }
+
+    auto pid = getpid();
+    out << R"({"displayTimeUnit":"ms","traceEvents":[)";
+    auto separator = "\n";
+    for (const auto &ring: rings) {
+        std::string name;
+        {
+            std::lock_guard lock(registryMutex);
+            name = ring->name.empty() ? fmt::format("thread-{}", ring->tid) : ring->name;
+        }
+        out << separator << fmt::format(R"({{"name":"thread_name","ph":"M","pid":{},"tid":{},"args":{{"name":"{}"}}}})",
+                                        pid, ring->tid, escape(name.c_str()));
+        separator = ",\n";
+
+        auto head = ring->head.load(std::memory_order_acquire);
+        auto first = head > eventsPerThread ? head - eventsPerThread : 0;
+        for (auto index = first; index < head; index++) {
+            auto &event = ring->events[index % eventsPerThread];
+            auto eventName = event.name.load(std::memory_order_relaxed);
+            auto start = event.start.load(std::memory_order_relaxed);
+            auto end = event.end.load(std::memory_order_relaxed);
+
+            // The writer may have wrapped around onto this slot while we were reading it
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (ring->head.load(std::memory_order_relaxed) >= index + eventsPerThread || eventName == nullptr) {
+                continue;
+            }
+
+            out << separator << fmt::format(R"({{"name":"{}","ph":"X","pid":{},"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+                                            escape(eventName), pid, ring->tid, start / 1000.0,
+                                            (end - start) / 1000.0);
+        }
+    }
+    out << "\n]}\n";
+
+    // Exited threads will not record again, their events are in this dump
+    {
+        std::lock_guard lock(registryMutex);
+        for (const auto &ring: rings) {
+            if (!ring->exited) {
+                continue;
+            }
+            auto registered = std::find(registry.begin(), registry.end(), ring);
+            if (registered != registry.end()) {
+                releaseRing(registered);
+            }
+        }
+    }
+    return static_cast<bool>(out);
+}
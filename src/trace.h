@@ -0,0 +1,88 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * Scoped trace spans exported as Chrome trace-event JSON, which loads in Perfetto and chrome://tracing.
+ *
+ * Every thread records into its own fixed-size ring, so recording takes no lock once the thread's ring exists. The
+ * newest events of each ring are kept. With tracing disabled a span costs one relaxed atomic load.
+ */
+class Trace {
+public:
+    static void enable(bool enable) {
+        enabled_.store(enable, std::memory_order_relaxed);
+    }
+
+    static bool enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Names the calling thread in the exported trace. name must outlive the thread.
+     */
+    static void setThreadName(const char *name);
+
+    /**
+     * Makes the given signal request a dump, see dumpRequested().
+     */
+    static void installDumpSignal(int signal);
+
+    /**
+     * Returns true once per received dump signal.
+     */
+    static bool dumpRequested() {
+        return dumpRequested_.exchange(false, std::memory_order_relaxed);
+    }
+
+    /**
+     * Writes all rings to path. Safe to call while other threads keep recording.
+     */
+    static bool dump(const std::string &path);
+
+    static uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * name must outlive the trace, string literals and __FUNCTION__ do.
+     */
+    static void record(const char *name, uint64_t start, uint64_t end);
+
+private:
+    static void onDumpSignal(int signal);
+
+    static std::atomic<bool> enabled_;
+    static std::atomic<bool> dumpRequested_;
+};
+
+class TraceSpan {
+public:
+    explicit TraceSpan(const char *name) : name(Trace::enabled() ? name : nullptr),
+                                           start(this->name != nullptr ? Trace::now() : 0) {}
+
+    ~TraceSpan() {
+        if (name != nullptr) {
+            Trace::record(name, start, Trace::now());
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *name;
+    uint64_t start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(name)
+
+#endif // TRACE_H
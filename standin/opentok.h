@@ -0,0 +1,253 @@
+#ifndef OPENTOK_STANDIN_H
+#define OPENTOK_STANDIN_H
+
+/**
+ * Local stand-in for the OpenTok Linux SDK, built with -DOPENTOK_STANDIN=ON.
+ *
+ * Declares the subset of the SDK's C API this program uses, with the same names, signatures and callback struct
+ * field order, so the sources build unchanged against either. See opentok_standin.cpp for what the stand-in does.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef int otc_bool;
+#define OTC_TRUE 1
+#define OTC_FALSE 0
+
+typedef int otc_status;
+#define OTC_SUCCESS 0
+#define OTC_ERROR 1
+
+typedef struct otc_session otc_session;
+typedef struct otc_publisher otc_publisher;
+typedef struct otc_subscriber otc_subscriber;
+typedef struct otc_stream otc_stream;
+typedef struct otc_connection otc_connection;
+typedef struct otc_video_frame otc_video_frame;
+typedef struct otc_video_capturer otc_video_capturer;
+typedef struct otc_audio_device otc_audio_device;
+
+enum otc_video_frame_format {
+    OTC_VIDEO_FRAME_FORMAT_UNKNOWN = 0,
+    OTC_VIDEO_FRAME_FORMAT_YUV420P = 1,
+    OTC_VIDEO_FRAME_FORMAT_NV12 = 2,
+    OTC_VIDEO_FRAME_FORMAT_NV21 = 3,
+    OTC_VIDEO_FRAME_FORMAT_YUY2 = 4,
+    OTC_VIDEO_FRAME_FORMAT_UYVY = 5,
+    OTC_VIDEO_FRAME_FORMAT_ARGB32 = 6,
+    OTC_VIDEO_FRAME_FORMAT_BGRA32 = 7,
+    OTC_VIDEO_FRAME_FORMAT_RGB24 = 8,
+    OTC_VIDEO_FRAME_FORMAT_ABGR32 = 9,
+    OTC_VIDEO_FRAME_FORMAT_MJPEG = 10,
+    OTC_VIDEO_FRAME_FORMAT_RGBA32 = 11,
+    OTC_VIDEO_FRAME_FORMAT_MAX = 12,
+    OTC_VIDEO_FRAME_FORMAT_COMPACT = 13
+};
+
+enum otc_video_frame_plane {
+    OTC_VIDEO_FRAME_PLANE_Y = 0,
+    OTC_VIDEO_FRAME_PLANE_U = 1,
+    OTC_VIDEO_FRAME_PLANE_V = 2,
+    OTC_VIDEO_FRAME_PLANE_PACKED = 0,
+    OTC_VIDEO_FRAME_PLANE_UV_INTERLEAVED = 1,
+    OTC_VIDEO_FRAME_PLANE_VU_INTERLEAVED = 1
+};
+
+enum otc_session_error_code {
+    OTC_SESSION_AUTHORIZATION_FAILURE = 1004,
+    OTC_SESSION_CONNECTION_FAILED = 1006,
+    OTC_SESSION_INTERNAL_ERROR = 2000
+};
+
+enum otc_publisher_error_code {
+    OTC_PUBLISHER_INTERNAL_ERROR = 2000,
+    OTC_PUBLISHER_UNABLE_TO_PUBLISH = 1500
+};
+
+enum otc_subscriber_error_code {
+    OTC_SUBSCRIBER_INTERNAL_ERROR = 2000,
+    OTC_SUBSCRIBER_STREAM_NOT_FOUND = 1600
+};
+
+struct otc_video_capturer_settings {
+    int format;
+    int width;
+    int height;
+    int fps;
+    otc_bool mirror_on_local_render;
+    int expected_delay;
+};
+
+struct otc_video_capturer_callbacks {
+    otc_bool (*init)(const otc_video_capturer *capturer, void *user_data);
+    otc_bool (*destroy)(const otc_video_capturer *capturer, void *user_data);
+    otc_bool (*start)(const otc_video_capturer *capturer, void *user_data);
+    otc_bool (*stop)(const otc_video_capturer *capturer, void *user_data);
+    otc_bool (*get_capture_settings)(const otc_video_capturer *capturer, void *user_data,
+                                     struct otc_video_capturer_settings *settings);
+    void *user_data;
+    void *reserved;
+};
+
+struct otc_audio_device_settings {
+    int sampling_rate;
+    int number_of_channels;
+};
+
+struct otc_audio_device_callbacks {
+    otc_bool (*init)(const otc_audio_device *audio_device, void *user_data);
+    otc_bool (*destroy)(const otc_audio_device *audio_device, void *user_data);
+    otc_bool (*init_capturer)(const otc_audio_device *audio_device, void *user_data);
+    otc_bool (*destroy_capturer)(const otc_audio_device *audio_device, void *user_data);
+    otc_bool (*start_capturer)(const otc_audio_device *audio_device, void *user_data);
+    otc_bool (*stop_capturer)(const otc_audio_device *audio_device, void *user_data);
+    otc_bool (*is_capturer_initialized)(const otc_audio_device *audio_device, void *user_data);
+    otc_bool (*is_capturer_started)(const otc_audio_device *audio_device, void *user_data);
+    int (*get_estimated_capture_delay)(const otc_audio_device *audio_device, void *user_data);
+    otc_bool (*get_capture_settings)(const otc_audio_device *audio_device, void *user_data,
+                                     struct otc_audio_device_settings *settings);
+    otc_bool (*init_renderer)(const otc_audio_device *audio_device, void *user_data);
+    otc_bool (*destroy_renderer)(const otc_audio_device *audio_device, void *user_data);
+    otc_bool (*start_renderer)(const otc_audio_device *audio_device, void *user_data);
+    otc_bool (*stop_renderer)(const otc_audio_device *audio_device, void *user_data);
+    otc_bool (*is_renderer_initialized)(const otc_audio_device *audio_device, void *user_data);
+    otc_bool (*is_renderer_started)(const otc_audio_device *audio_device, void *user_data);
+    int (*get_estimated_render_delay)(const otc_audio_device *audio_device, void *user_data);
+    otc_bool (*get_render_settings)(const otc_audio_device *audio_device, void *user_data,
+                                    struct otc_audio_device_settings *settings);
+    void *user_data;
+    void *reserved;
+};
+
+struct otc_session_callbacks {
+    void (*on_connected)(otc_session *session, void *user_data);
+    void (*on_reconnection_started)(otc_session *session, void *user_data);
+    void (*on_reconnected)(otc_session *session, void *user_data);
+    void (*on_disconnected)(otc_session *session, void *user_data);
+    void (*on_connection_created)(otc_session *session, void *user_data, const otc_connection *connection);
+    void (*on_connection_dropped)(otc_session *session, void *user_data, const otc_connection *connection);
+    void (*on_stream_received)(otc_session *session, void *user_data, const otc_stream *stream);
+    void (*on_stream_dropped)(otc_session *session, void *user_data, const otc_stream *stream);
+    void (*on_stream_has_audio_changed)(otc_session *session, void *user_data, const otc_stream *stream,
+                                        otc_bool has_audio);
+    void (*on_stream_has_video_changed)(otc_session *session, void *user_data, const otc_stream *stream,
+                                        otc_bool has_video);
+    void (*on_stream_video_dimensions_changed)(otc_session *session, void *user_data, const otc_stream *stream,
+                                               int width, int height);
+    void (*on_stream_video_type_changed)(otc_session *session, void *user_data, const otc_stream *stream,
+                                         int type);
+    void (*on_signal_received)(otc_session *session, void *user_data, const char *type, const char *signal,
+                               const otc_connection *connection);
+    void (*on_archive_started)(otc_session *session, void *user_data, const char *archive_id, const char *name);
+    void (*on_archive_stopped)(otc_session *session, void *user_data, const char *archive_id);
+    void (*on_error)(otc_session *session, void *user_data, const char *error_string,
+                     enum otc_session_error_code error);
+    void *user_data;
+    void *reserved;
+};
+
+struct otc_publisher_callbacks {
+    void (*on_stream_created)(otc_publisher *publisher, void *user_data, const otc_stream *stream);
+    void (*on_stream_destroyed)(otc_publisher *publisher, void *user_data, const otc_stream *stream);
+    void (*on_render_frame)(otc_publisher *publisher, void *user_data, const otc_video_frame *frame);
+    void (*on_audio_level_updated)(otc_publisher *publisher, void *user_data, float audio_level);
+    void (*on_audio_stats)(otc_publisher *publisher, void *user_data, void *audio_stats, size_t number_of_stats);
+    void (*on_video_stats)(otc_publisher *publisher, void *user_data, void *video_stats, size_t number_of_stats);
+    void (*on_error)(otc_publisher *publisher, void *user_data, const char *error_string,
+                     enum otc_publisher_error_code error_code);
+    void *user_data;
+    void *reserved;
+};
+
+struct otc_subscriber_callbacks {
+    void (*on_connected)(otc_subscriber *subscriber, void *user_data, const otc_stream *stream);
+    void (*on_disconnected)(otc_subscriber *subscriber, void *user_data);
+    void (*on_reconnected)(otc_subscriber *subscriber, void *user_data);
+    void (*on_render_frame)(otc_subscriber *subscriber, void *user_data, const otc_video_frame *frame);
+    void (*on_video_disabled)(otc_subscriber *subscriber, void *user_data, int reason);
+    void (*on_video_enabled)(otc_subscriber *subscriber, void *user_data, int reason);
+    void (*on_audio_disabled)(otc_subscriber *subscriber, void *user_data);
+    void (*on_audio_enabled)(otc_subscriber *subscriber, void *user_data);
+    void (*on_video_data_received)(otc_subscriber *subscriber, void *user_data);
+    void (*on_video_disable_warning)(otc_subscriber *subscriber, void *user_data);
+    void (*on_video_disable_warning_lifted)(otc_subscriber *subscriber, void *user_data);
+    void (*on_audio_stats)(otc_subscriber *subscriber, void *user_data, void *audio_stats);
+    void (*on_video_stats)(otc_subscriber *subscriber, void *user_data, void *video_stats);
+    void (*on_audio_level_updated)(otc_subscriber *subscriber, void *user_data, float audio_level);
+    void (*on_error)(otc_subscriber *subscriber, void *user_data, const char *error_string,
+                     enum otc_subscriber_error_code error);
+    void *user_data;
+    void *reserved;
+};
+
+otc_status otc_init(void *reserved);
+
+otc_status otc_destroy(void);
+
+otc_session *otc_session_new(const char *apikey, const char *session_id, const struct otc_session_callbacks *callbacks);
+
+otc_status otc_session_delete(otc_session *session);
+
+otc_status otc_session_connect(otc_session *session, const char *token);
+
+otc_status otc_session_disconnect(otc_session *session);
+
+otc_status otc_session_publish(otc_session *session, otc_publisher *publisher);
+
+otc_status otc_session_unpublish(otc_session *session, otc_publisher *publisher);
+
+otc_status otc_session_subscribe(otc_session *session, otc_subscriber *subscriber);
+
+otc_status otc_session_unsubscribe(otc_session *session, otc_subscriber *subscriber);
+
+otc_publisher *otc_publisher_new(const char *name, const struct otc_video_capturer_callbacks *capturer_callbacks,
+                                 const struct otc_publisher_callbacks *callbacks);
+
+otc_status otc_publisher_delete(otc_publisher *publisher);
+
+otc_subscriber *otc_subscriber_new(const otc_stream *stream, const struct otc_subscriber_callbacks *callbacks);
+
+otc_status otc_subscriber_delete(otc_subscriber *subscriber);
+
+const char *otc_stream_get_id(const otc_stream *stream);
+
+otc_video_frame *otc_video_frame_new(enum otc_video_frame_format format, int width, int height,
+                                     const uint8_t *buffer);
+
+otc_status otc_video_frame_delete(otc_video_frame *frame);
+
+enum otc_video_frame_format otc_video_frame_get_format(const otc_video_frame *frame);
+
+int otc_video_frame_get_width(const otc_video_frame *frame);
+
+int otc_video_frame_get_height(const otc_video_frame *frame);
+
+const uint8_t *otc_video_frame_get_plane_binary_data(const otc_video_frame *frame, enum otc_video_frame_plane plane);
+
+int otc_video_frame_get_plane_stride(const otc_video_frame *frame, enum otc_video_frame_plane plane);
+
+int otc_video_frame_get_plane_width(const otc_video_frame *frame, enum otc_video_frame_plane plane);
+
+int otc_video_frame_get_plane_height(const otc_video_frame *frame, enum otc_video_frame_plane plane);
+
+otc_video_frame *otc_video_frame_convert(enum otc_video_frame_format format, const otc_video_frame *input_frame);
+
+otc_status otc_video_capturer_provide_frame(const otc_video_capturer *capturer, int rotation,
+                                            const otc_video_frame *frame);
+
+otc_status otc_set_audio_device(const struct otc_audio_device_callbacks *callbacks);
+
+size_t otc_audio_device_write_capture_data(const int16_t *data, size_t number_of_samples);
+
+size_t otc_audio_device_read_render_data(int16_t *data, size_t number_of_samples);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // OPENTOK_STANDIN_H
@@ -0,0 +1,490 @@
+#include "opentok.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "metrics.h"
+#include "otk_thread.h"
+#include "trace.h"
+
+/**
+ * Stand-in for libopentok, for soak and scale runs that should exercise the whole program for hours without a real
+ * session.
+ *
+ * A session runs one event thread, like the SDK's signaling thread, and every callback into the application is made
+ * from it in the SDK's order: connecting starts the audio renderer and reports on_connected, publishing starts the
+ * video capturer (and the audio capturer with the first publisher) and reports on_stream_created, unpublishing and
+ * disconnecting tear them down again. Frames given to otc_video_capturer_provide_frame are read once, the way an
+ * encoder would, and counted. There are no other participants, so no stream is ever received.
+ */
+
+struct otc_stream {
+    std::string id;
+};
+
+struct otc_video_capturer {
+};
+
+struct otc_audio_device {
+};
+
+struct otc_connection {
+};
+
+struct otc_publisher {
+    std::string name;
+    otc_video_capturer_callbacks capturerCallbacks{};
+    otc_publisher_callbacks callbacks{};
+    otc_video_capturer capturer;
+    otc_stream stream;
+    bool capturing{false};
+};
+
+struct otc_subscriber {
+    const otc_stream *stream;
+    otc_subscriber_callbacks callbacks{};
+};
+
+struct otc_video_frame {
+    otc_video_frame_format format;
+    int width;
+    int height;
+    const uint8_t *data;
+    // Set when the frame owns its pixels
+    std::vector<uint8_t> storage;
+};
+
+struct otc_session {
+    otc_session_callbacks callbacks{};
+
+    otk_thread_t eventThread{};
+    std::mutex eventMutex;
+    std::condition_variable eventCondition;
+    std::deque<std::function<void()>> events;
+    bool exitEventThread{false};
+
+    // Only touched on the event thread
+    bool connected{false};
+    std::vector<otc_publisher *> publishing;
+};
+
+namespace {
+
+std::mutex audioDeviceMutex;
+bool hasAudioDevice = false;
+otc_audio_device_callbacks audioDeviceCallbacks{};
+otc_audio_device audioDevice;
+bool audioCapturerStarted = false;
+bool audioRendererStarted = false;
+
+int streamCounter = 0;
+
+// Looked up on first use, the registry may not be constructed yet during static initialization
+Metric &framesProvided() {
+    static auto &metric = Metrics::get("standin.frames_provided");
+    return metric;
+}
+
+Metric &audioSamplesCaptured() {
+    static auto &metric = Metrics::get("standin.audio_samples_captured");
+    return metric;
+}
+
+Metric &audioSamplesRendered() {
+    static auto &metric = Metrics::get("standin.audio_samples_rendered");
+    return metric;
+}
+
+// Keeps the frame read from being optimized away
+std::atomic<uint64_t> frameChecksum{0};
+
+void post(otc_session *session, std::function<void()> event) {
+    {
+        std::lock_guard lock(session->eventMutex);
+        session->events.push_back(std::move(event));
+    }
+    session->eventCondition.notify_one();
+}
+
+otk_thread_func_return_type event_thread_start_function(void *arg) {
+    auto session = static_cast<otc_session *>(arg);
+    Trace::setThreadName("standin-events");
+
+    std::unique_lock lock(session->eventMutex);
+    while (true) {
+        session->eventCondition.wait(lock, [session]() {
+            return session->exitEventThread || !session->events.empty();
+        });
+        if (session->events.empty()) {
+            break;
+        }
+        auto event = std::move(session->events.front());
+        session->events.pop_front();
+        lock.unlock();
+        event();
+        lock.lock();
+    }
+
+    otk_thread_func_return_value;
+}
+
+void startAudioCapturer() {
+    std::lock_guard lock(audioDeviceMutex);
+    if (hasAudioDevice && !audioCapturerStarted && audioDeviceCallbacks.start_capturer != nullptr) {
+        audioCapturerStarted = audioDeviceCallbacks.start_capturer(&audioDevice, audioDeviceCallbacks.user_data);
+    }
+}
+
+void stopAudioCapturer() {
+    std::lock_guard lock(audioDeviceMutex);
+    if (audioCapturerStarted && audioDeviceCallbacks.destroy_capturer != nullptr) {
+        audioDeviceCallbacks.destroy_capturer(&audioDevice, audioDeviceCallbacks.user_data);
+    }
+    audioCapturerStarted = false;
+}
+
+void startAudioRenderer() {
+    std::lock_guard lock(audioDeviceMutex);
+    if (hasAudioDevice && !audioRendererStarted && audioDeviceCallbacks.start_renderer != nullptr) {
+        audioRendererStarted = audioDeviceCallbacks.start_renderer(&audioDevice, audioDeviceCallbacks.user_data);
+    }
+}
+
+void stopAudioRenderer() {
+    std::lock_guard lock(audioDeviceMutex);
+    if (audioRendererStarted && audioDeviceCallbacks.stop_renderer != nullptr) {
+        audioDeviceCallbacks.stop_renderer(&audioDevice, audioDeviceCallbacks.user_data);
+    }
+    if (audioRendererStarted && audioDeviceCallbacks.destroy_renderer != nullptr) {
+        audioDeviceCallbacks.destroy_renderer(&audioDevice, audioDeviceCallbacks.user_data);
+    }
+    audioRendererStarted = false;
+}
+
+void stopCapturer(otc_publisher *publisher) {
+    if (publisher->capturing && publisher->capturerCallbacks.destroy != nullptr) {
+        publisher->capturerCallbacks.destroy(&publisher->capturer, publisher->capturerCallbacks.user_data);
+    }
+    publisher->capturing = false;
+}
+
+// Runs on the event thread
+void unpublish(otc_session *session, otc_publisher *publisher) {
+    auto it = std::find(session->publishing.begin(), session->publishing.end(), publisher);
+    if (it == session->publishing.end()) {
+        return;
+    }
+    session->publishing.erase(it);
+
+    stopCapturer(publisher);
+    if (publisher->callbacks.on_stream_destroyed != nullptr) {
+        publisher->callbacks.on_stream_destroyed(publisher, publisher->callbacks.user_data, &publisher->stream);
+    }
+    if (session->publishing.empty()) {
+        stopAudioCapturer();
+    }
+}
+
+// Runs on the event thread
+void disconnect(otc_session *session) {
+    if (!session->connected) {
+        return;
+    }
+    while (!session->publishing.empty()) {
+        unpublish(session, session->publishing.back());
+    }
+    stopAudioRenderer();
+    session->connected = false;
+    if (session->callbacks.on_disconnected != nullptr) {
+        session->callbacks.on_disconnected(session, session->callbacks.user_data);
+    }
+}
+
+int planeCount(otc_video_frame_format format) {
+    return format == OTC_VIDEO_FRAME_FORMAT_YUV420P ? 3 : 1;
+}
+
+int planeWidth(const otc_video_frame *frame, int plane) {
+    if (frame->format == OTC_VIDEO_FRAME_FORMAT_YUV420P) {
+        return plane == 0 ? frame->width : (frame->width + 1) / 2;
+    }
+    return frame->width;
+}
+
+int planeHeight(const otc_video_frame *frame, int plane) {
+    if (frame->format == OTC_VIDEO_FRAME_FORMAT_YUV420P) {
+        return plane == 0 ? frame->height : (frame->height + 1) / 2;
+    }
+    return frame->height;
+}
+
+int planeStride(const otc_video_frame *frame, int plane) {
+    switch (frame->format) {
+        case OTC_VIDEO_FRAME_FORMAT_ARGB32:
+        case OTC_VIDEO_FRAME_FORMAT_BGRA32:
+        case OTC_VIDEO_FRAME_FORMAT_ABGR32:
+        case OTC_VIDEO_FRAME_FORMAT_RGBA32:
+            return frame->width * 4;
+        case OTC_VIDEO_FRAME_FORMAT_RGB24:
+            return frame->width * 3;
+        case OTC_VIDEO_FRAME_FORMAT_YUY2:
+        case OTC_VIDEO_FRAME_FORMAT_UYVY:
+            return frame->width * 2;
+        default:
+            return planeWidth(frame, plane);
+    }
+}
+
+const uint8_t *planeData(const otc_video_frame *frame, int plane) {
+    auto data = frame->data;
+    for (int i = 0; i < plane && i < planeCount(frame->format); i++) {
+        data += static_cast<size_t>(planeStride(frame, i)) * planeHeight(frame, i);
+    }
+    return data;
+}
+
+}
+
+otc_status otc_init(void *reserved) {
+    return OTC_SUCCESS;
+}
+
+otc_status otc_destroy(void) {
+    stopAudioCapturer();
+    stopAudioRenderer();
+    std::lock_guard lock(audioDeviceMutex);
+    hasAudioDevice = false;
+    return OTC_SUCCESS;
+}
+
+otc_session *otc_session_new(const char *apikey, const char *session_id,
+                             const struct otc_session_callbacks *callbacks) {
+    auto session = new otc_session;
+    session->callbacks = *callbacks;
+    if (otk_thread_create(&session->eventThread, &event_thread_start_function, session) != 0) {
+        delete session;
+        return nullptr;
+    }
+    return session;
+}
+
+otc_status otc_session_delete(otc_session *session) {
+    if (session == nullptr) {
+        return OTC_ERROR;
+    }
+    post(session, [session]() {
+        disconnect(session);
+    });
+    {
+        std::lock_guard lock(session->eventMutex);
+        session->exitEventThread = true;
+    }
+    session->eventCondition.notify_one();
+    otk_thread_join(session->eventThread);
+    delete session;
+    return OTC_SUCCESS;
+}
+
+otc_status otc_session_connect(otc_session *session, const char *token) {
+    post(session, [session]() {
+        if (session->connected) {
+            return;
+        }
+        session->connected = true;
+        startAudioRenderer();
+        if (session->callbacks.on_connected != nullptr) {
+            session->callbacks.on_connected(session, session->callbacks.user_data);
+        }
+    });
+    return OTC_SUCCESS;
+}
+
+otc_status otc_session_disconnect(otc_session *session) {
+    post(session, [session]() {
+        disconnect(session);
+    });
+    return OTC_SUCCESS;
+}
+
+otc_status otc_session_publish(otc_session *session, otc_publisher *publisher) {
+    post(session, [session, publisher]() {
+        if (!session->connected || publisher->capturing) {
+            return;
+        }
+        auto &capturer = publisher->capturerCallbacks;
+        otc_video_capturer_settings settings{};
+        if (capturer.get_capture_settings != nullptr) {
+            capturer.get_capture_settings(&publisher->capturer, capturer.user_data, &settings);
+        }
+        if (capturer.start != nullptr && !capturer.start(&publisher->capturer, capturer.user_data)) {
+            if (publisher->callbacks.on_error != nullptr) {
+                publisher->callbacks.on_error(publisher, publisher->callbacks.user_data, "capturer did not start",
+                                              OTC_PUBLISHER_UNABLE_TO_PUBLISH);
+            }
+            return;
+        }
+        publisher->capturing = true;
+        session->publishing.push_back(publisher);
+        startAudioCapturer();
+        if (publisher->callbacks.on_stream_created != nullptr) {
+            publisher->callbacks.on_stream_created(publisher, publisher->callbacks.user_data, &publisher->stream);
+        }
+    });
+    return OTC_SUCCESS;
+}
+
+otc_status otc_session_unpublish(otc_session *session, otc_publisher *publisher) {
+    post(session, [session, publisher]() {
+        unpublish(session, publisher);
+    });
+    return OTC_SUCCESS;
+}
+
+otc_status otc_session_subscribe(otc_session *session, otc_subscriber *subscriber) {
+    return OTC_SUCCESS;
+}
+
+otc_status otc_session_unsubscribe(otc_session *session, otc_subscriber *subscriber) {
+    return OTC_SUCCESS;
+}
+
+otc_publisher *otc_publisher_new(const char *name, const struct otc_video_capturer_callbacks *capturer_callbacks,
+                                 const struct otc_publisher_callbacks *callbacks) {
+    auto publisher = new otc_publisher;
+    publisher->name = name != nullptr ? name : "";
+    publisher->capturerCallbacks = *capturer_callbacks;
+    publisher->callbacks = *callbacks;
+    publisher->stream.id = "standin-stream-" + std::to_string(++streamCounter);
+    if (capturer_callbacks->init != nullptr) {
+        capturer_callbacks->init(&publisher->capturer, capturer_callbacks->user_data);
+    }
+    return publisher;
+}
+
+otc_status otc_publisher_delete(otc_publisher *publisher) {
+    if (publisher == nullptr) {
+        return OTC_ERROR;
+    }
+    // The session is gone by now, so nothing else can reach the capturer
+    stopCapturer(publisher);
+    delete publisher;
+    return OTC_SUCCESS;
+}
+
+otc_subscriber *otc_subscriber_new(const otc_stream *stream, const struct otc_subscriber_callbacks *callbacks) {
+    auto subscriber = new otc_subscriber;
+    subscriber->stream = stream;
+    subscriber->callbacks = *callbacks;
+    return subscriber;
+}
+
+otc_status otc_subscriber_delete(otc_subscriber *subscriber) {
+    delete subscriber;
+    return OTC_SUCCESS;
+}
+
+const char *otc_stream_get_id(const otc_stream *stream) {
+    return stream != nullptr ? stream->id.c_str() : "";
+}
+
+otc_video_frame *otc_video_frame_new(enum otc_video_frame_format format, int width, int height,
+                                     const uint8_t *buffer) {
+    if (buffer == nullptr || width <= 0 || height <= 0) {
+        return nullptr;
+    }
+    return new otc_video_frame{format, width, height, buffer, {}};
+}
+
+otc_status otc_video_frame_delete(otc_video_frame *frame) {
+    delete frame;
+    return OTC_SUCCESS;
+}
+
+enum otc_video_frame_format otc_video_frame_get_format(const otc_video_frame *frame) {
+    return frame->format;
+}
+
+int otc_video_frame_get_width(const otc_video_frame *frame) {
+    return frame->width;
+}
+
+int otc_video_frame_get_height(const otc_video_frame *frame) {
+    return frame->height;
+}
+
+const uint8_t *otc_video_frame_get_plane_binary_data(const otc_video_frame *frame, enum otc_video_frame_plane plane) {
+    return planeData(frame, plane);
+}
+
+int otc_video_frame_get_plane_stride(const otc_video_frame *frame, enum otc_video_frame_plane plane) {
+    return planeStride(frame, plane);
+}
+
+int otc_video_frame_get_plane_width(const otc_video_frame *frame, enum otc_video_frame_plane plane) {
+    return planeWidth(frame, plane);
+}
+
+int otc_video_frame_get_plane_height(const otc_video_frame *frame, enum otc_video_frame_plane plane) {
+    return planeHeight(frame, plane);
+}
+
+otc_video_frame *otc_video_frame_convert(enum otc_video_frame_format format, const otc_video_frame *input_frame) {
+    // Only copies, the stand-in never delivers remote frames that would need converting
+    if (input_frame == nullptr || format != input_frame->format) {
+        return nullptr;
+    }
+    size_t size = 0;
+    for (int plane = 0; plane < planeCount(format); plane++) {
+        size += static_cast<size_t>(planeStride(input_frame, plane)) * planeHeight(input_frame, plane);
+    }
+    auto frame = new otc_video_frame{format, input_frame->width, input_frame->height, nullptr, {}};
+    frame->storage.assign(input_frame->data, input_frame->data + size);
+    frame->data = frame->storage.data();
+    return frame;
+}
+
+otc_status otc_video_capturer_provide_frame(const otc_video_capturer *capturer, int rotation,
+                                            const otc_video_frame *frame) {
+    if (capturer == nullptr || frame == nullptr) {
+        return OTC_ERROR;
+    }
+
+    // Read every row once, as the encoder's colour conversion would
+    uint64_t sum = 0;
+    for (int plane = 0; plane < planeCount(frame->format); plane++) {
+        auto data = planeData(frame, plane);
+        auto stride = static_cast<size_t>(planeStride(frame, plane));
+        for (int row = 0; row < planeHeight(frame, plane); row++) {
+            for (size_t offset = 0; offset < stride; offset += 64) {
+                sum += data[row * stride + offset];
+            }
+        }
+    }
+    frameChecksum.fetch_add(sum, std::memory_order_relaxed);
+    framesProvided().add();
+    return OTC_SUCCESS;
+}
+
+otc_status otc_set_audio_device(const struct otc_audio_device_callbacks *callbacks) {
+    std::lock_guard lock(audioDeviceMutex);
+    audioDeviceCallbacks = *callbacks;
+    hasAudioDevice = true;
+    return OTC_SUCCESS;
+}
+
+size_t otc_audio_device_write_capture_data(const int16_t *data, size_t number_of_samples) {
+    audioSamplesCaptured().add(static_cast<int64_t>(number_of_samples));
+    return number_of_samples;
+}
+
+size_t otc_audio_device_read_render_data(int16_t *data, size_t number_of_samples) {
+    memset(data, 0, number_of_samples * sizeof(int16_t));
+    audioSamplesRendered().add(static_cast<int64_t>(number_of_samples));
+    return number_of_samples;
+}